@@ -6,19 +6,50 @@
 //
 
 #include "BarrierOptionAnalyzer.hpp"
+#include "Instrumentation.hpp"
 #include "RNG.hpp"
 #include "PathGenerator.hpp"
+#include "ControlVariateEstimator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 
-BarrierOptionAnalyzer::BarrierOptionAnalyzer(const BarrierOption& barrier_option) : barrier_option_(barrier_option), option_(barrier_option_.GetVanillaOption()) {}
+BarrierOptionAnalyzer::BarrierOptionAnalyzer(const BarrierOption& barrier_option) : barrier_option_(barrier_option), option_(barrier_option_.GetVanillaOption()), discount_(std::exp(-option_.r_ * option_.T_)), cache_(nullptr) {}
+
+void BarrierOptionAnalyzer::UseCache(ResultCache* cache, const std::string& tag) {
+    cache_ = cache;
+    cache_tag_ = tag;
+}
 
 double BarrierOptionAnalyzer::DiscountAndAverage(const std::vector<double>& vec) const {
+    MCP_TIME_STAGE(StageReduction);
     double res = std::accumulate(vec.cbegin(), vec.cend(), 0.);
     res /= vec.size();
-    res *= std::exp(-option_.r_ * option_.T_);
+    res *= discount_;
     return res;
 }
 
 double BarrierOptionAnalyzer::Price(std::size_t path_length, std::size_t num_paths, unsigned seed) const {
+    if (!cache_) return this->PriceUncached(path_length, num_paths, seed);
+    
+    // Every input of the estimate
+    CacheKey key("BarrierOptionAnalyzer::Price/2");
+    key.Add(option_.t_).Add(option_.S_).Add(option_.K_).Add(option_.T_).Add(option_.sigma_).Add(option_.r_).Add(option_.q_);
+    key.Add(barrier_option_.GetBarrier()).Add(std::uint64_t(barrier_option_.GetBarrierType())).Add(std::uint64_t(barrier_option_.GetOptionType()));
+    key.Add(std::uint64_t(path_length)).Add(std::uint64_t(num_paths)).Add(std::uint64_t(seed));
+    
+    // The generator state after the simulation is cached with the price, so a hit leaves the generator
+    // exactly where a miss would and memoization does not change later draws
+    if (std::optional<std::vector<double>> hit = cache_->Get(key, cache_tag_)) {
+        LCE_uniform::reseed(static_cast<unsigned long>((*hit)[1]));
+        return hit->front();
+    }
+    const double res = this->PriceUncached(path_length, num_paths, seed);
+    cache_->Put(key, {res, static_cast<double>(LCE_uniform::state())}, cache_tag_);
+    return res;
+}
+
+double BarrierOptionAnalyzer::PriceUncached(std::size_t path_length, std::size_t num_paths, unsigned seed) const {
     
     // Reseed generator
     LCE_uniform::reseed(seed);
@@ -26,14 +57,157 @@ double BarrierOptionAnalyzer::Price(std::size_t path_length, std::size_t num_pat
     // Generate vector of standard Gaussian
     std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
     
-    // From standard Gaussian get asset endpoint prices
-    std::vector<std::vector<double>> S(OneAssetWithPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z).S);
+    // From standard Gaussian get asset paths, stored time-major
+    OneAssetPathBlock_BS S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z);
     
-    // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), barrier_option_);
+    // Get payoff, one time step at a time across paths
+    std::vector<double> V(barrier_option_(S));
     
     double value = this->DiscountAndAverage(V);
     
     return value;
 }
+
+double BarrierOptionAnalyzer::Price(const ScenarioStore& store) const {
+    
+    store.CheckModel(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_);
+    const std::size_t path_length = store.PathLength();
+    std::vector<double> buffer;
+    double sum = 0.;
+    
+    for (std::size_t b = 0; b < store.NumBlocks(); b++) {
+        const std::size_t n = store.BlockPaths(b);
+        const double* values = store.Block(b, buffer);
+        
+        // Get payoff, one time step at a time across paths
+        std::vector<double> V;
+        if (store.Kind() == ScenarioNormals) {
+            V = barrier_option_(OneAssetPathBlock_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, n, path_length, values));
+        } else {
+            OneAssetPathBlock S(store.S0(), n, path_length);
+            std::copy(values, values + n * path_length, S.S.begin());
+            V = barrier_option_(S);
+        }
+        sum += std::accumulate(V.cbegin(), V.cend(), 0.);
+    }
+    
+    return discount_ * sum / store.NumPaths();
+}
+
+std::vector<double> BarrierOptionAnalyzer::DiscountedPayoffs(std::size_t path_length, std::size_t num_paths) const {
+    
+    // Generate vector of standard Gaussian
+    // With an odd path length and an odd path count, the pair-wise generator returns one spare path: drop it
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    Z.resize(num_paths);
+    
+    // From standard Gaussian get asset paths, stored time-major
+    OneAssetPathBlock_BS S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z);
+    
+    // Get payoff
+    std::vector<double> V(barrier_option_(S));
+    for (double& v : V) {
+        v *= discount_;
+    }
+    
+    return V;
+}
+
+std::vector<double> BarrierOptionAnalyzer::Price(std::size_t path_length, std::size_t num_paths, const MertonJump& jump, unsigned seed) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    
+    // From standard Gaussian get asset paths, stored time-major
+    OneAssetPathBlock_Merton S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, jump, Z);
+    
+    // Get payoff
+    std::vector<double> V(barrier_option_(S));
+    
+    double value = this->DiscountAndAverage(V);
+    
+    // Control variate: the vanilla option on the same paths
+    const EuropeanOptionType option_type = barrier_option_.GetOptionType();
+    const double* S_T = S.Step(S.path_length - 1);
+    std::vector<double> V_vanilla(S.num_paths);
+    for (std::size_t p = 0; p < S.num_paths; p++) {
+        V_vanilla[p] = (option_type == Call) ? std::max(S_T[p] - option_.K_, 0.) : std::max(option_.K_ - S_T[p], 0.);
+    }
+    
+    for (std::size_t p = 0; p < S.num_paths; p++) {
+        V[p] *= discount_;
+        V_vanilla[p] *= discount_;
+    }
+    
+    double W_hat = ControlVariateEstimator::Accumulate(V, {V_vanilla}, {jump.EuropeanPrice(option_, option_type)}).Estimate().value;
+    
+    return std::vector<double>({value, W_hat});
+}
+
+double BarrierOptionAnalyzer::Price(const LocalVolGrid& grid, std::size_t num_paths, unsigned seed) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, grid.path_length));
+    
+    // From standard Gaussian get asset paths, stored time-major
+    OneAssetPathBlock_LocalVol S(option_.S_, option_.r_, option_.q_, grid, Z);
+    
+    // Get payoff
+    std::vector<double> V(barrier_option_(S));
+    
+    return this->DiscountAndAverage(V);
+}
+
+double BarrierOptionAnalyzer::Price(std::size_t path_length, std::size_t num_paths, const TermStructure& curves, unsigned seed) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    TimeGridIntegrals grid(curves.OnGrid(option_.T_, path_length));
+    
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    
+    // From standard Gaussian get asset paths, stored time-major
+    OneAssetPathBlock_BS S(option_.S_, grid, Z);
+    
+    // Get payoff
+    std::vector<double> V(barrier_option_(S));
+    
+    return std::accumulate(V.cbegin(), V.cend(), 0.) / V.size() * grid.discount;
+}
+
+PayoffDistribution BarrierOptionAnalyzer::PriceDistribution(std::size_t path_length, std::size_t num_paths, unsigned seed, unsigned num_threads, std::size_t block_size) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    DistributionAccumulator accumulator(num_threads);
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t block_paths = std::min(block_size, num_paths - done);
+        
+        // Generate vector of standard Gaussian
+        // With an odd path length and an odd block, the pair-wise generator returns one spare path: drop it
+        std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(block_paths, path_length));
+        Z.resize(block_paths);
+        
+        // From standard Gaussian get asset paths, stored time-major
+        OneAssetPathBlock_BS S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z);
+        
+        // Get discounted payoff
+        std::vector<double> V(barrier_option_(S));
+        for (double& v : V) {
+            v *= discount_;
+        }
+        
+        accumulator.Add(V);
+    }
+    
+    return accumulator.Result();
+}
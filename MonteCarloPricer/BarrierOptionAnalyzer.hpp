@@ -9,17 +9,53 @@
 #define BarrierOptionAnalyzer_hpp
 
 #include "PathDependentOption.hpp"
+#include "JumpDiffusion.hpp"
+#include "LocalVolatility.hpp"
+#include "QuantileSketch.hpp"
+#include "ResultCache.hpp"
+#include "ScenarioStore.hpp"
 
 class BarrierOptionAnalyzer {
 private:
     BarrierOption barrier_option_;
     EuropeanOption option_;
+    double discount_;   // exp(-r T), cached
+    
+    ResultCache* cache_;    // Optional, not owned
+    std::string cache_tag_;
+    
+    double PriceUncached(std::size_t path_length, std::size_t num_paths, unsigned seed) const;
     
 public:
     BarrierOptionAnalyzer(const BarrierOption& barrier_option);
     
+    // Memoize Price(path_length, num_paths, seed) in cache, tagged for invalidation (e.g. with the underlying)
+    // A hit restores the generator state the simulation left, so later draws are the same with or without the cache
+    void UseCache(ResultCache* cache, const std::string& tag = "");
+    
     double Price(std::size_t path_length, std::size_t num_paths, unsigned seed = 1) const;
     
+    // Common random numbers from a scenario file: stored normals drive this option's model (read in place),
+    // stored paths are priced as they are, and must come from this option's S0, T, sigma, r and q
+    double Price(const ScenarioStore& store) const;
+    
+    // Discounted payoffs of the next num_paths paths, continuing from the current generator state (no reseed)
+    std::vector<double> DiscountedPayoffs(std::size_t path_length, std::size_t num_paths) const;
+    
+    // Merton jump-diffusion
+    // return: value, value with the vanilla option (priced by the Merton series) as control variate
+    std::vector<double> Price(std::size_t path_length, std::size_t num_paths, const MertonJump& jump, unsigned seed = 1) const;
+    
+    // Local volatility; the grid fixes the path length and can be shared by a whole book
+    double Price(const LocalVolGrid& grid, std::size_t num_paths, unsigned seed = 1) const;
+    
+    // Piecewise rates, dividend yield and volatility, integrated once over the path grid
+    double Price(std::size_t path_length, std::size_t num_paths, const TermStructure& curves, unsigned seed = 1) const;
+    
+    // Distribution of the discounted payoff (mean, standard error, quantiles, expected shortfall)
+    // Simulated block_size paths at a time, so memory stays bounded at any number of paths
+    PayoffDistribution PriceDistribution(std::size_t path_length, std::size_t num_paths, unsigned seed = 1, unsigned num_threads = 0, std::size_t block_size = 1 << 14) const;
+    
     double DiscountAndAverage(const std::vector<double>& vec) const;
 };
 
@@ -0,0 +1,187 @@
+//
+//  ControlVariateEstimator.cpp
+//  MonteCarloPricer
+//
+
+#include "ControlVariateEstimator.hpp"
+#include "Instrumentation.hpp"
+#include "Serialization.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+ControlVariateEstimator::ControlVariateEstimator(const std::vector<double>& control_means) : k_(control_means.size()), control_means_(control_means), count_(0), mean_(k_ + 1, 0.), comoment_((k_ + 1) * (k_ + 1), 0.), delta_(k_ + 1), delta_new_(k_ + 1) {}
+
+void ControlVariateEstimator::Add(double y, const double* x) {
+    const std::size_t d = k_ + 1;
+    count_++;
+    
+    // delta = z - old mean; the co-moment update uses (z - new mean) on the other side
+    for (std::size_t i = 0; i < d; i++) {
+        double z = (i == 0) ? y : x[i - 1];
+        delta_[i] = z - mean_[i];
+        mean_[i] += delta_[i] / count_;
+        delta_new_[i] = z - mean_[i];
+    }
+    for (std::size_t i = 0; i < d; i++) {
+        for (std::size_t j = 0; j < d; j++) {
+            comoment_[i * d + j] += delta_[i] * delta_new_[j];
+        }
+    }
+}
+
+void ControlVariateEstimator::Add(double y, const std::vector<double>& x) {
+    assert(x.size() == k_);
+    this->Add(y, x.data());
+}
+
+void ControlVariateEstimator::Merge(const ControlVariateEstimator& other) {
+    assert(other.k_ == k_);
+    if (other.count_ == 0) return;
+    
+    const std::size_t d = k_ + 1;
+    const double n_a = count_;
+    const double n_b = other.count_;
+    const double n = n_a + n_b;
+    
+    std::vector<double> delta(d);
+    for (std::size_t i = 0; i < d; i++) {
+        delta[i] = other.mean_[i] - mean_[i];
+    }
+    for (std::size_t i = 0; i < d; i++) {
+        for (std::size_t j = 0; j < d; j++) {
+            comoment_[i * d + j] += other.comoment_[i * d + j] + delta[i] * delta[j] * n_a * n_b / n;
+        }
+    }
+    for (std::size_t i = 0; i < d; i++) {
+        mean_[i] += delta[i] * n_b / n;
+    }
+    count_ += other.count_;
+}
+
+void ControlVariateEstimator::Save(ByteWriter& writer) const {
+    writer.PutDoubles(control_means_);
+    writer.PutUInt64(count_);
+    writer.PutDoubles(mean_);
+    writer.PutDoubles(comoment_);
+}
+
+ControlVariateEstimator ControlVariateEstimator::Load(ByteReader& reader) {
+    ControlVariateEstimator res(reader.GetDoubles());
+    res.count_ = reader.GetUInt64();
+    std::vector<double> mean(reader.GetDoubles());
+    std::vector<double> comoment(reader.GetDoubles());
+    if (mean.size() != res.mean_.size() || comoment.size() != res.comoment_.size()) throw std::runtime_error("serialized ControlVariateEstimator has inconsistent sizes");
+    res.mean_ = std::move(mean);
+    res.comoment_ = std::move(comoment);
+    return res;
+}
+
+ControlVariateResults ControlVariateEstimator::Estimate() const {
+    const std::size_t d = k_ + 1;
+    const double n = count_;
+    
+    // No spread to regress on below two samples: the plain mean, as RunningStatistics reports it
+    if (count_ < 2) {
+        return ControlVariateResults({mean_[0], 0., mean_[0], 0., std::vector<double>(k_, 0.), 1.});
+    }
+    
+    // Solve C_xx b = C_xy by Gaussian elimination with partial pivoting
+    std::vector<double> M(k_ * (k_ + 1));
+    for (std::size_t i = 0; i < k_; i++) {
+        for (std::size_t j = 0; j < k_; j++) {
+            M[i * (k_ + 1) + j] = comoment_[(i + 1) * d + (j + 1)];
+        }
+        M[i * (k_ + 1) + k_] = comoment_[(i + 1) * d];
+    }
+    for (std::size_t c = 0; c < k_; c++) {
+        std::size_t pivot = c;
+        for (std::size_t i = c + 1; i < k_; i++) {
+            if (std::abs(M[i * (k_ + 1) + c]) > std::abs(M[pivot * (k_ + 1) + c])) pivot = i;
+        }
+        for (std::size_t j = 0; j <= k_; j++) {
+            std::swap(M[c * (k_ + 1) + j], M[pivot * (k_ + 1) + j]);
+        }
+        for (std::size_t i = c + 1; i < k_; i++) {
+            double f = M[i * (k_ + 1) + c] / M[c * (k_ + 1) + c];
+            for (std::size_t j = c; j <= k_; j++) {
+                M[i * (k_ + 1) + j] -= f * M[c * (k_ + 1) + j];
+            }
+        }
+    }
+    std::vector<double> b(k_);
+    for (std::size_t c = k_; c-- > 0;) {
+        double sum = M[c * (k_ + 1) + k_];
+        for (std::size_t j = c + 1; j < k_; j++) {
+            sum -= M[c * (k_ + 1) + j] * b[j];
+        }
+        // A control without variance (e.g. constant) gets no weight
+        b[c] = (M[c * (k_ + 1) + c] != 0.) ? sum / M[c * (k_ + 1) + c] : 0.;
+    }
+    
+    ControlVariateResults res;
+    res.coefficients = b;
+    res.raw_value = mean_[0];
+    res.value = mean_[0];
+    
+    // Residual sum of squares of Y on X, at the optimal b: C_yy - b^T C_xy
+    double residual = comoment_[0];
+    for (std::size_t i = 0; i < k_; i++) {
+        res.value -= b[i] * (mean_[i + 1] - control_means_[i]);
+        residual -= b[i] * comoment_[(i + 1) * d];
+    }
+    
+    double raw_variance = comoment_[0] / (n - 1.);
+    double variance = std::max(residual, 0.) / (n - 1.);
+    res.raw_std_error = std::sqrt(raw_variance / n);
+    res.std_error = std::sqrt(variance / n);
+    // A perfect control leaves no residual variance: an infinite reduction (or none, if Y was constant)
+    res.variance_reduction = (variance > 0.) ? raw_variance / variance : (raw_variance > 0.) ? std::numeric_limits<double>::infinity() : 1.;
+    
+    return res;
+}
+
+ControlVariateEstimator ControlVariateEstimator::Accumulate(const std::vector<double>& Y, const std::vector<std::vector<double>>& X, const std::vector<double>& control_means, unsigned num_threads) {
+    MCP_TIME_STAGE(StageReduction);
+    const std::size_t k = control_means.size();
+    assert(X.size() == k);
+    
+    if (num_threads == 0) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const std::size_t N = Y.size();
+    const std::size_t num_chunks = (N + accumulate_chunk - 1) / accumulate_chunk;
+    num_threads = static_cast<unsigned>(std::max<std::size_t>(std::min<std::size_t>(num_threads, num_chunks), 1));
+    
+    // Thread t takes chunks t, t + num_threads, ...
+    std::vector<ControlVariateEstimator> partial(num_chunks, ControlVariateEstimator(control_means));
+    auto work = [&](unsigned t) {
+        std::vector<double> x(k);
+        for (std::size_t c = t; c < num_chunks; c += num_threads) {
+            for (std::size_t i = c * accumulate_chunk; i < std::min(N, (c + 1) * accumulate_chunk); i++) {
+                for (std::size_t j = 0; j < k; j++) {
+                    x[j] = X[j][i];
+                }
+                partial[c].Add(Y[i], x.data());
+            }
+        }
+    };
+    if (num_threads == 1) {
+        work(0);
+    } else {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < num_threads; t++) {
+            threads.emplace_back(work, t);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    
+    ControlVariateEstimator res(control_means);
+    for (const ControlVariateEstimator& estimator : partial) {
+        res.Merge(estimator);
+    }
+    return res;
+}
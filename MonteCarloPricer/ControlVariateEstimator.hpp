@@ -0,0 +1,71 @@
+//
+//  ControlVariateEstimator.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ControlVariateEstimator_hpp
+#define ControlVariateEstimator_hpp
+
+#include <iostream>
+#include <vector>
+
+class ByteWriter;
+class ByteReader;
+
+struct ControlVariateResults {
+    double value;                       // Controlled estimate
+    double std_error;
+    double raw_value;                   // Plain sample mean
+    double raw_std_error;
+    std::vector<double> coefficients;   // Optimal b-hat, one per control
+    double variance_reduction;          // Var(Y) / Var(Y - b^T (X - mu))
+    
+    void Print() const {
+        std::cout << value << '\t' << std_error << '\t' << raw_value << '\t' << raw_std_error << '\t' << variance_reduction << std::endl;
+    }
+};
+
+class ControlVariateEstimator {
+    // Streaming estimator of E[Y] with k controls X of known means
+    // Keeps the means and the (k+1) x (k+1) co-moment matrix of (Y, X), updated one sample at a time (Welford),
+    // so no precision is lost to cancellation at large N. Partial estimators merge exactly (Chan et al.)
+private:
+    std::size_t k_;
+    std::vector<double> control_means_;
+    
+    std::size_t count_;
+    std::vector<double> mean_;      // (Y, X_1, ..., X_k)
+    std::vector<double> comoment_;  // sum (z_i - mean_i) (z_j - mean_j), row-major (k+1) x (k+1)
+    
+    // Scratch space for Add()
+    std::vector<double> delta_;
+    std::vector<double> delta_new_;
+    
+public:
+    ControlVariateEstimator(const std::vector<double>& control_means);
+    ~ControlVariateEstimator() = default;
+    
+    // x: the k controls of this sample
+    void Add(double y, const double* x);
+    void Add(double y, const std::vector<double>& x);
+    
+    void Merge(const ControlVariateEstimator& other);
+    
+    // Exact state (the control means included), for checkpoints and partial results
+    void Save(ByteWriter& writer) const;
+    static ControlVariateEstimator Load(ByteReader& reader);
+    
+    std::size_t Count() const { return count_; }
+    const std::vector<double>& ControlMeans() const { return control_means_; }
+    
+    // Below two samples: the plain mean, zero standard errors and zero coefficients
+    ControlVariateResults Estimate() const;
+    
+    // Accumulates the samples (Y[i], X[0][i], ..., X[k-1][i]) in fixed chunks of accumulate_chunk samples
+    // and merges them in chunk order; num_threads (0: hardware concurrency) only decides who runs the chunks,
+    // so the result is the same for every thread count
+    static constexpr std::size_t accumulate_chunk = 1 << 16;
+    static ControlVariateEstimator Accumulate(const std::vector<double>& Y, const std::vector<std::vector<double>>& X, const std::vector<double>& control_means, unsigned num_threads = 1);
+};
+
+#endif /* ControlVariateEstimator_hpp */
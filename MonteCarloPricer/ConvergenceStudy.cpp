@@ -0,0 +1,94 @@
+//
+//  ConvergenceStudy.cpp
+//  MonteCarloPricer
+//
+
+#include "ConvergenceStudy.hpp"
+#include "RNG.hpp"
+#include "Serialization.hpp"
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+namespace {
+
+const char magic[8] = {'M', 'C', 'P', 'C', 'K', '0', '0', '1'};
+const std::uint64_t byte_order = 0x0102030405060708;
+
+}
+
+ConvergenceStudy::ConvergenceStudy(const Sampler& sampler, const std::vector<double>& control_means, unsigned long seed) : sampler_(sampler), estimator_(control_means), rng_state_(seed), seconds_(0.) {}
+
+ConvergenceStudy::ConvergenceStudy(const std::function<std::vector<double> (std::size_t)>& sampler, unsigned long seed) : ConvergenceStudy([sampler](std::size_t n) { return std::vector<std::vector<double>>({sampler(n)}); }, {}, seed) {}
+
+ConvergencePoint ConvergenceStudy::ExtendTo(std::size_t N) {
+    
+    if (N > estimator_.Count()) {
+        const auto start = std::chrono::steady_clock::now();
+        
+        // Resume the generator where the last extension stopped
+        LCE_uniform::reseed(rng_state_);
+        std::vector<std::vector<double>> columns(sampler_(N - estimator_.Count()));
+        rng_state_ = LCE_uniform::state();
+        
+        // Feed the new samples
+        const std::size_t k = columns.size() - 1;
+        std::vector<double> x(k);
+        for (std::size_t i = 0; i < columns[0].size(); i++) {
+            for (std::size_t c = 0; c < k; c++) {
+                x[c] = columns[c + 1][i];
+            }
+            estimator_.Add(columns[0][i], x);
+        }
+        
+        seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    return ConvergencePoint({estimator_.Count(), estimator_.Estimate(), seconds_});
+}
+
+std::vector<ConvergencePoint> ConvergenceStudy::Run(const std::vector<std::size_t>& checkpoints) {
+    std::vector<ConvergencePoint> res;
+    for (std::size_t N : checkpoints) {
+        res.push_back(this->ExtendTo(N));
+    }
+    return res;
+}
+
+void ConvergenceStudy::Save(const std::string& path) const {
+    ByteWriter writer;
+    writer.PutBytes(std::string_view(magic, sizeof(magic)));
+    writer.PutUInt64(byte_order);
+    writer.PutUInt64(rng_state_);
+    writer.PutDouble(seconds_);
+    estimator_.Save(writer);
+    writer.WriteFile(path);
+}
+
+void ConvergenceStudy::Load(const std::string& path) {
+    const std::string data = ByteReader::ReadFile(path);
+    ByteReader reader(data);
+    if (reader.GetBytes(sizeof(magic)) != std::string_view(magic, sizeof(magic))) throw std::runtime_error(path + ": not a checkpoint");
+    if (reader.GetUInt64() != byte_order) throw std::runtime_error(path + ": written with another byte order");
+    
+    const unsigned long rng_state = reader.GetUInt64();
+    const double seconds = reader.GetDouble();
+    ControlVariateEstimator estimator(ControlVariateEstimator::Load(reader));
+    if (estimator.ControlMeans() != estimator_.ControlMeans()) throw std::runtime_error(path + ": checkpoint of a study with other controls");
+    
+    rng_state_ = rng_state;
+    seconds_ = seconds;
+    estimator_ = std::move(estimator);
+}
+
+ConvergencePoint ConvergenceStudy::ExtendTo(std::size_t N, std::size_t batch, const std::string& path) {
+    assert(batch > 0);
+    if (std::filesystem::exists(path)) this->Load(path);
+    
+    while (this->Count() < N) {
+        this->ExtendTo(std::min(N, this->Count() + batch));
+        this->Save(path);
+    }
+    return this->ExtendTo(N);
+}
@@ -0,0 +1,68 @@
+//
+//  ConvergenceStudy.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ConvergenceStudy_hpp
+#define ConvergenceStudy_hpp
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ControlVariateEstimator.hpp"
+
+struct ConvergencePoint {
+    std::size_t N;
+    ControlVariateResults estimate;
+    double seconds;     // Cumulative simulation time
+    
+    void Print() const {
+        std::cout << N << '\t' << estimate.value << '\t' << estimate.std_error << '\t' << estimate.raw_value << '\t' << estimate.raw_std_error << '\t' << seconds << std::endl;
+    }
+};
+
+class ConvergenceStudy {
+    // Running estimate at increasing sample sizes, extending the same sample instead of restarting
+    // Keeps the accumulator and the generator position between checkpoints, so each checkpoint only simulates
+    // the new samples; the estimate at N is the one a single run of N samples from the same seed would give.
+    // The sampler simulates the next n samples from the current LCE_uniform state and returns the columns (Y, X_1, ..., X_k)
+    // of the target and of the controls. Normals are drawn in pairs, so n times the path length should be even.
+public:
+    using Sampler = std::function<std::vector<std::vector<double>> (std::size_t)>;
+    
+private:
+    Sampler sampler_;
+    ControlVariateEstimator estimator_;
+    unsigned long rng_state_;
+    double seconds_;
+    
+public:
+    // control_means: known means of the controls (none: plain sample mean)
+    ConvergenceStudy(const Sampler& sampler, const std::vector<double>& control_means = {}, unsigned long seed = 1);
+    // Single column, no controls
+    ConvergenceStudy(const std::function<std::vector<double> (std::size_t)>& sampler, unsigned long seed = 1);
+    ~ConvergenceStudy() = default;
+    
+    // Simulates N - Count() more samples (none if N <= Count()); moves this thread's LCE_uniform
+    ConvergencePoint ExtendTo(std::size_t N);
+    // One point per checkpoint, in increasing order
+    std::vector<ConvergencePoint> Run(const std::vector<std::size_t>& checkpoints);
+    
+    // Checkpoint files, so that a long run survives being stopped: the accumulator, the generator position
+    // and the elapsed time, bit for bit. Resuming and extending to N gives exactly the estimate of an
+    // uninterrupted ExtendTo(N), under the same pairing condition as above for every batch.
+    // Save replaces path atomically (see ByteWriter::WriteFile).
+    void Save(const std::string& path) const;
+    // Replaces the state with a checkpoint of a study with the same controls; throws std::runtime_error otherwise
+    // The sampler is not recorded: resuming with another one continues a different sample.
+    void Load(const std::string& path);
+    // ExtendTo(N) in steps of batch samples, saving to path after each step; starts from the checkpoint
+    // at path if there is one (which may already hold more than N samples)
+    ConvergencePoint ExtendTo(std::size_t N, std::size_t batch, const std::string& path);
+    
+    std::size_t Count() const { return estimator_.Count(); }
+    unsigned long RngState() const { return rng_state_; }
+};
+
+#endif /* ConvergenceStudy_hpp */
@@ -32,6 +32,8 @@ EuropeanOption::EuropeanOption(double t, double S, double K, double T, double si
     r_disc_ = std::exp(-r * (T-t));
 }
 
+EuropeanOption::EuropeanOption(double t, double S, double K, double T, const TermStructure& curves) : EuropeanOption(t, S, K, T, curves.AverageVol(t, T), curves.AverageRate(t, T), curves.AverageYield(t, T)) {}
+
 double EuropeanOption::Call() const {
     return S_ * q_disc_ * Nd1_ - K_ * r_disc_ * Nd2_;
 }
@@ -91,13 +93,13 @@ double EuropeanOption::RhoPut() const {
 }
 
 std::function<double(double, double)> EuropeanOption::CallPayoff() const {
-    return [&](double S, double t)->double {
+    return [&](double S, double)->double {
         return std::max(S - K_, 0.);
     };
 }
 
 std::function<double(double, double)> EuropeanOption::PutPayoff() const {
-    return [&](double S, double t)->double {
+    return [&](double S, double)->double {
         return std::max(K_ - S, 0.);
     };
 }
@@ -9,6 +9,7 @@
 #define EuropeanOption_hpp
 
 #include <functional>
+#include "TermStructure.hpp"
 
 enum EuropeanOptionType {
     Call,
@@ -42,6 +43,9 @@ private:
     
 public:
     EuropeanOption(double t, double S, double K, double T, double sigma, double r, double q);
+    // Term-structure parameters, through their flat equivalents over [t, T]
+    // (the terminal distribution, hence the closed-form price, only depends on the integrals)
+    EuropeanOption(double t, double S, double K, double T, const TermStructure& curves);
     ~EuropeanOption() = default;
     
     std::function<double (double, double)> CallPayoff() const;
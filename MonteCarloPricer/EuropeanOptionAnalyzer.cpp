@@ -6,20 +6,41 @@
 //
 
 #include "EuropeanOptionAnalyzer.hpp"
+#include "Instrumentation.hpp"
 #include "RNG.hpp"
 #include "PathGenerator.hpp"
+#include "ControlVariateEstimator.hpp"
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <numeric>
 
-EuropeanOptionAnalyzer::EuropeanOptionAnalyzer(const EuropeanOption& option) : option_(option) {}
+EuropeanOptionAnalyzer::EuropeanOptionAnalyzer(const EuropeanOption& option) : option_(option), discount_(std::exp(-option.r_ * option.T_)), cache_(nullptr) {}
+
+void EuropeanOptionAnalyzer::UseCache(ResultCache* cache, const std::string& tag) {
+    cache_ = cache;
+    cache_tag_ = tag;
+}
 
 double EuropeanOptionAnalyzer::DiscountAndAverage(const std::vector<double>& vec) const {
+    return this->DiscountAndAverage(vec, discount_);
+}
+
+double EuropeanOptionAnalyzer::DiscountAndAverage(const std::vector<double>& vec, double discount) const {
+    MCP_TIME_STAGE(StageReduction);
     double res = std::accumulate(vec.cbegin(), vec.cend(), 0.);
     res /= vec.size();
-    res *= std::exp(-option_.r_ * option_.T_);
+    res *= discount;
     return res;
 }
 
+std::vector<double> EuropeanOptionAnalyzer::EvaluatePayoff(const std::vector<double>& S, const std::function<double (double)>& payoff) const {
+    MCP_TIME_STAGE(StagePayoff);
+    std::vector<double> V(S.size());
+    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    return V;
+}
+
 EuropeanOptionResults EuropeanOptionAnalyzer::Analyze(std::size_t N, unsigned long seed) const {
     
     // Reseed RNG machine
@@ -60,6 +81,25 @@ EuropeanOptionResults EuropeanOptionAnalyzer::Analyze(std::size_t N, unsigned lo
 }
 
 double EuropeanOptionAnalyzer::Price(std::size_t N, const OptionType& type, const VarRed& modifier, unsigned long seed) const {
+    if (!cache_) return this->PriceUncached(N, type, modifier, seed);
+    
+    // Every input of the estimate
+    CacheKey key("EuropeanOptionAnalyzer::Price/2");
+    key.Add(option_.t_).Add(option_.S_).Add(option_.K_).Add(option_.T_).Add(option_.sigma_).Add(option_.r_).Add(option_.q_);
+    key.Add(std::uint64_t(N)).Add(std::uint64_t(type)).Add(std::uint64_t(modifier)).Add(std::uint64_t(seed));
+    
+    // The generator state after the simulation is cached with the price, so a hit leaves the generator
+    // exactly where a miss would and memoization does not change later draws
+    if (std::optional<std::vector<double>> hit = cache_->Get(key, cache_tag_)) {
+        LCE_uniform::reseed(static_cast<unsigned long>((*hit)[1]));
+        return hit->front();
+    }
+    const double res = this->PriceUncached(N, type, modifier, seed);
+    cache_->Put(key, {res, static_cast<double>(LCE_uniform::state())}, cache_tag_);
+    return res;
+}
+
+double EuropeanOptionAnalyzer::PriceUncached(std::size_t N, const OptionType& type, const VarRed& modifier, unsigned long seed) const {
     
     // Reseed RNG machine
     LCE_uniform::reseed(seed);
@@ -97,6 +137,90 @@ double EuropeanOptionAnalyzer::Price(std::size_t N, const OptionType& type, cons
     }
 }
 
+std::vector<double> EuropeanOptionAnalyzer::Price(std::size_t N, const OptionType& type, const MertonJump& jump, unsigned long seed) const {
+    
+    // Reseed RNG machine
+    LCE_uniform::reseed(seed);
+    
+    std::function<double (double)> payoff;
+    
+    switch (type) {
+        case call:
+            payoff = std::bind(option_.CallPayoff(), std::placeholders::_1, option_.T_);
+            break;
+        case put:
+            payoff = std::bind(option_.PutPayoff(), std::placeholders::_1, option_.T_);
+            break;
+    }
+    
+    // Generate vector of standard Gaussian
+    std::vector<double> Z(StandardGaussianMatrix::gen(N));
+    
+    // From standard Gaussian get asset endpoint prices
+    OneAssetNoPath_Merton S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, jump, Z);
+    
+    // Get payoff
+    std::vector<double> V(this->EvaluatePayoff(S.S, payoff));
+    
+    double value = this->DiscountAndAverage(V);
+    
+    // Control variate: given n jumps, log S_T is normal with mean log S0 + (r - q - lambda k - sigma^2 / 2) T + n mu
+    // and variance sigma^2 T + n delta^2, so the conditional price is Black-Scholes from a shifted spot;
+    // over the jump count its mean is the Merton series price. One price per distinct count.
+    const EuropeanOptionType option_type = (type == call) ? Call : Put;
+    const double tau = option_.T_ - option_.t_;
+    const unsigned max_jumps = S.jumps.empty() ? 0 : *std::max_element(S.jumps.cbegin(), S.jumps.cend());
+    std::vector<double> conditional(max_jumps + 1);
+    for (unsigned n = 0; n <= max_jumps; n++) {
+        const double S_n = option_.S_ * std::exp(n * (jump.mu + jump.delta * jump.delta / 2.) - jump.lambda * jump.Compensator() * tau);
+        const double sigma_n = std::sqrt(option_.sigma_ * option_.sigma_ + n * jump.delta * jump.delta / tau);
+        EuropeanOption option_n(option_.t_, S_n, option_.K_, option_.T_, sigma_n, option_.r_, option_.q_);
+        conditional[n] = (option_type == Call) ? option_n.Call() : option_n.Put();
+    }
+    
+    std::vector<double> V_conditional(N);
+    for (std::size_t i = 0; i < N; i++) {
+        V[i] *= discount_;
+        V_conditional[i] = conditional[S.jumps[i]];
+    }
+    
+    double W_hat = ControlVariateEstimator::Accumulate(V, {V_conditional}, {jump.EuropeanPrice(option_, option_type)}).Estimate().value;
+    
+    return std::vector<double>({value, W_hat});
+}
+
+double EuropeanOptionAnalyzer::Price(std::size_t N, const OptionType& type, const TermStructure& curves, unsigned long seed) const {
+    
+    // Reseed RNG machine
+    LCE_uniform::reseed(seed);
+    
+    std::function<double (double)> payoff;
+    
+    switch (type) {
+        case call:
+            payoff = std::bind(option_.CallPayoff(), std::placeholders::_1, option_.T_);
+            break;
+        case put:
+            payoff = std::bind(option_.PutPayoff(), std::placeholders::_1, option_.T_);
+            break;
+    }
+    
+    // One step: the terminal distribution only depends on the integrals over [0, T]
+    TimeGridIntegrals grid(curves.OnGrid(option_.T_, 1));
+    
+    // Generate vector of standard Gaussian
+    std::vector<double> Z(StandardGaussianMatrix::gen(N + N % 2));
+    Z.resize(N);
+    
+    // From standard Gaussian get asset endpoint prices
+    std::vector<double> S(OneAssetNoPath_BS(option_.S_, grid, Z).S);
+    
+    // Get payoff
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
+    
+    return this->DiscountAndAverage(V, grid.discount);
+}
+
 double EuropeanOptionAnalyzer::PriceVanilla(std::size_t N, const std::function<double (double)>& payoff) const {
     // Generate vector of standard Gaussian
     std::vector<double> Z(StandardGaussianMatrix::gen(N));
@@ -105,13 +229,92 @@ double EuropeanOptionAnalyzer::PriceVanilla(std::size_t N, const std::function<d
     std::vector<double> S(OneAssetNoPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z).S);
     
     // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
     
     return this->DiscountAndAverage(V);
 }
 
+double EuropeanOptionAnalyzer::Price(const ScenarioStore& store, const OptionType& type) const {
+    
+    std::function<double (double)> payoff;
+    
+    switch (type) {
+        case call:
+            payoff = std::bind(option_.CallPayoff(), std::placeholders::_1, option_.T_);
+            break;
+        case put:
+            payoff = std::bind(option_.PutPayoff(), std::placeholders::_1, option_.T_);
+            break;
+    }
+    
+    store.CheckModel(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_);
+    const std::size_t path_length = store.PathLength();
+    std::vector<double> buffer;
+    double sum = 0.;
+    
+    for (std::size_t b = 0; b < store.NumBlocks(); b++) {
+        const std::size_t n = store.BlockPaths(b);
+        const double* values = store.Block(b, buffer);
+        
+        // Endpoints of the block
+        std::vector<double> S;
+        if (store.Kind() == ScenarioNormals) {
+            OneAssetPathBlock_BS paths(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, n, path_length, values, {path_length - 1});
+            S.swap(paths.S);
+        } else {
+            S.assign(values + (path_length - 1) * n, values + path_length * n);
+        }
+        
+        // Get payoff
+        std::vector<double> V(this->EvaluatePayoff(S, payoff));
+        sum += std::accumulate(V.cbegin(), V.cend(), 0.);
+    }
+    
+    return discount_ * sum / store.NumPaths();
+}
+
+PayoffDistribution EuropeanOptionAnalyzer::PriceDistribution(std::size_t N, const OptionType& type, unsigned long seed, unsigned num_threads, std::size_t block_size) const {
+    
+    // Reseed RNG machine
+    LCE_uniform::reseed(seed);
+    
+    std::function<double (double)> payoff;
+    
+    switch (type) {
+        case call:
+            payoff = std::bind(option_.CallPayoff(), std::placeholders::_1, option_.T_);
+            break;
+        case put:
+            payoff = std::bind(option_.PutPayoff(), std::placeholders::_1, option_.T_);
+            break;
+    }
+    
+    DistributionAccumulator accumulator(num_threads);
+    for (std::size_t done = 0; done < N; done += block_size) {
+        const std::size_t block_N = std::min(block_size, N - done);
+        
+        // Generate vector of standard Gaussian
+        std::vector<double> Z(StandardGaussianMatrix::gen(block_N + block_N % 2));
+        Z.resize(block_N);
+        
+        // From standard Gaussian get asset prices
+        std::vector<double> S(OneAssetNoPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z).S);
+        
+        // Get discounted payoff
+        std::vector<double> V(S.size());
+        std::transform(S.cbegin(), S.cend(), V.begin(), [&](double s)->double { return discount_ * payoff(s); });
+        
+        accumulator.Add(V);
+    }
+    
+    return accumulator.Result();
+}
+
 std::vector<double> EuropeanOptionAnalyzer::Price(std::size_t N, const std::function<double (double)>& payoff, const Dividend& proportional, const Dividend& fixed, unsigned seed) const {
+    return this->Price(N, payoff, DividendSchedule(option_.T_, option_.sigma_, option_.r_, option_.q_, proportional, fixed), seed);
+}
+
+std::vector<double> EuropeanOptionAnalyzer::Price(std::size_t N, const std::function<double (double)>& payoff, const DividendSchedule& schedule, unsigned seed) const {
     
     // Reseed generator
     LCE_uniform::reseed(seed);
@@ -119,17 +322,16 @@ std::vector<double> EuropeanOptionAnalyzer::Price(std::size_t N, const std::func
     std::vector<double> res;
     
     // Generate vector of standard Gaussian
-    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(N, proportional.dates.size() + fixed.dates.size() + 1));
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(N, schedule.Intervals()));
     
     // From standard Gaussian get asset endpoint prices
-    std::vector<std::vector<double>> S_path(OneAssetWithPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z, proportional, fixed).S);
+    std::vector<std::vector<double>> S_path(OneAssetWithPath_BS(option_.S_, Z, schedule).S);
     
     std::vector<double> S(S_path.size());
     std::transform(S_path.cbegin(), S_path.cend(), S.begin(), [](const std::vector<double>& vec){ return vec.back(); });
     
     // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
     
     double value = this->DiscountAndAverage(V);
     
@@ -138,7 +340,7 @@ std::vector<double> EuropeanOptionAnalyzer::Price(std::size_t N, const std::func
     // Get no-dividend S
     std::vector<double> S_nodiv(S.size());
     
-    auto sqrt_of_time_diff(this->FindSqrtOfTimeDiff(proportional, fixed));
+    const std::vector<double>& sqrt_of_time_diff = schedule.SqrtTimeDiff();
     
 //    double t0 = 1. / 6., t1 = 1. / 6., t2 = 1. / 6., t3 = 1. / 12.;
     auto ZtoSNoDiv = [&](const std::vector<double>& z_path)->double {
@@ -159,28 +361,34 @@ std::vector<double> EuropeanOptionAnalyzer::Price(std::size_t N, const std::func
     std::vector<double> delta(S.size());
     std::transform(S_nodiv.cbegin(), S_nodiv.cend(), S.cbegin(), delta.begin(), FindDelta);
     double delta_hat = this->DiscountAndAverage(delta);
-    for (double div : proportional.dividends) {
-        delta_hat *= (1. - div);
-    }
+    delta_hat *= schedule.ProportionalFactor();
     res.push_back(delta_hat);
     
     // Control variates
     
+    // Control: the same payoff without dividends, with its Black-Scholes value as known mean
     std::vector<double> V_nodiv(S.size());
     std::transform(S_nodiv.cbegin(), S_nodiv.cend(), V_nodiv.begin(), payoff);
     
-    double b_hat = this->ControlVariateCoefficient(V, V_nodiv);
+    auto discount = [&](std::vector<double>& vec, double factor) {
+        for (double& v : vec) {
+            v *= discount_ * factor;
+        }
+    };
+    discount(V, 1.);
+    discount(V_nodiv, 1.);
     
-    double W_hat = value - b_hat * (this->DiscountAndAverage(V_nodiv) - option_.Put());
+    double W_hat = ControlVariateEstimator::Accumulate(V, {V_nodiv}, {option_.Put()}).Estimate().value;
     
     res.push_back(W_hat);
     
     std::vector<double> delta_nodiv(delta.size());
     std::transform(S_nodiv.cbegin(), S_nodiv.cend(), S_nodiv.cbegin(), delta_nodiv.begin(), FindDelta);
     
-    double b_delta_hat = this->ControlVariateCoefficient(delta, delta_nodiv);
+    discount(delta, schedule.ProportionalFactor());
+    discount(delta_nodiv, 1.);
     
-    double W_delta_hat = delta_hat - b_delta_hat * (this->DiscountAndAverage(delta_nodiv) - option_.DeltaPut());
+    double W_delta_hat = ControlVariateEstimator::Accumulate(delta, {delta_nodiv}, {option_.DeltaPut()}).Estimate().value;
     
     res.push_back(W_delta_hat);
 //    std::vector<double> W(delta.size());
@@ -202,26 +410,17 @@ double EuropeanOptionAnalyzer::PriceCV(std::size_t N, const std::function<double
     std::vector<double> S(OneAssetNoPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z).S);
     
     // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
     
     // Discount payoff
     for (double& v : V) {
-        v *= std::exp(-option_.r_ * option_.T_);
+        v *= discount_;
     }
-        
-    double sum_SV = std::inner_product(S.cbegin(), S.cend(), V.cbegin(), 0.);
-    double sum_SS = std::inner_product(S.cbegin(), S.cend(), S.cbegin(), 0.);
-    double sum_S = std::accumulate(S.cbegin(), S.cend(), 0.);
-    double sum_V = std::accumulate(V.cbegin(), V.cend(), 0.);
     
-    double b_hat = (sum_SV - sum_S * sum_V / static_cast<double>(S.size())) / (sum_SS - sum_S * sum_S / static_cast<double>(S.size()));
+    // Control: S_T, with known mean S0 exp((r - q) T)
+    ControlVariateEstimator estimator(ControlVariateEstimator::Accumulate(V, {S}, {std::exp((option_.r_ - option_.q_) * option_.T_) * option_.S_}));
     
-//    double b_hat = this->ControlVariateCoefficient(V, S);
-    
-    double W_hat = sum_V / V.size() - b_hat * (sum_S / S.size() - std::exp(option_.r_ * option_.T_) * option_.S_);
-    
-    return W_hat;
+    return estimator.Estimate().value;
 }
 
 // Antithetic variables
@@ -238,8 +437,7 @@ double EuropeanOptionAnalyzer::PriceAV(std::size_t N, const std::function<double
     S.insert(S.end(), more_S.cbegin(), more_S.cend());
     
     // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
     
     return this->DiscountAndAverage(V);
 }
@@ -254,12 +452,11 @@ double EuropeanOptionAnalyzer::PriceMM(std::size_t N, const std::function<double
     std::vector<double> S(OneAssetNoPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z).S);
     
     // Adjust S to "match moments"
-    double S_multiplier = option_.S_ * std::exp(option_.r_ * option_.T_) / std::accumulate(S.cbegin(), S.cend(), 0.) * S.size();
+    double S_multiplier = option_.S_ * std::exp((option_.r_ - option_.q_) * option_.T_) / std::accumulate(S.cbegin(), S.cend(), 0.) * S.size();
     std::transform(S.cbegin(), S.cend(), S.begin(), [=](double s)->double { return S_multiplier * s; });
     
     // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
     
     return this->DiscountAndAverage(V);
 }
@@ -273,52 +470,44 @@ double EuropeanOptionAnalyzer::PriceMMCV(std::size_t N, const std::function<doub
     std::vector<double> S(OneAssetNoPath_BS(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z).S);
     
     // Adjust S to "match moments"
-    double S_multiplier = option_.S_ * std::exp(option_.r_ * option_.T_) / std::accumulate(S.cbegin(), S.cend(), 0.) * S.size();
+    double S_multiplier = option_.S_ * std::exp((option_.r_ - option_.q_) * option_.T_) / std::accumulate(S.cbegin(), S.cend(), 0.) * S.size();
     std::transform(S.cbegin(), S.cend(), S.begin(), [=](double s)->double { return S_multiplier * s; });
     
     // Get payoff
-    std::vector<double> V(S.size());
-    std::transform(S.cbegin(), S.cend(), V.begin(), payoff);
+    std::vector<double> V(this->EvaluatePayoff(S, payoff));
     
     // Discount payoff
     for (double& v : V) {
-        v *= std::exp(-option_.r_ * option_.T_);
+        v *= discount_;
     }
-        
-    double sum_SV = std::inner_product(S.cbegin(), S.cend(), V.cbegin(), 0.);
-    double sum_SS = std::inner_product(S.cbegin(), S.cend(), S.cbegin(), 0.);
-    double sum_S = std::accumulate(S.cbegin(), S.cend(), 0.);
-    double sum_V = std::accumulate(V.cbegin(), V.cend(), 0.);
     
-    double b_hat = (sum_SV - sum_S * sum_V / static_cast<double>(S.size())) / (sum_SS - sum_S * sum_S / static_cast<double>(S.size()));
+    // Control: S_T, with known mean S0 exp((r - q) T)
+    ControlVariateEstimator estimator(ControlVariateEstimator::Accumulate(V, {S}, {std::exp((option_.r_ - option_.q_) * option_.T_) * option_.S_}));
     
-    double W_hat = sum_V / V.size() - b_hat * (sum_S / S.size() - std::exp(option_.r_ * option_.T_) * option_.S_);
-    
-    return W_hat;
+    return estimator.Estimate().value;
 }
 
-double EuropeanOptionAnalyzer::ControlVariateCoefficient(const std::vector<double>& dependent_variable, const std::vector<double>& independent_variable) const {
-    
-    assert(dependent_variable.size() == independent_variable.size());
+std::vector<std::vector<double>> EuropeanOptionAnalyzer::DiscountedPayoffs(std::size_t N, const std::function<double (double)>& payoff, const DividendSchedule& schedule) const {
     
-    double sum_dep_indep = std::inner_product(independent_variable.cbegin(), independent_variable.cend(), dependent_variable.cbegin(), 0.);
-    double sum_indep_indep = std::inner_product(independent_variable.cbegin(), independent_variable.cend(), independent_variable.cbegin(), 0.);;
-    double sum_dep = std::accumulate(dependent_variable.cbegin(), dependent_variable.cend(), 0.);
-    double sum_indep = std::accumulate(independent_variable.cbegin(), independent_variable.cend(), 0.);
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(N, schedule.Intervals()));
     
-    return (sum_dep_indep - sum_dep * sum_indep / static_cast<double>(independent_variable.size())) / (sum_indep_indep - sum_indep * sum_indep / static_cast<double>(independent_variable.size()));
-}
-
-std::vector<double> EuropeanOptionAnalyzer::FindSqrtOfTimeDiff(const Dividend& proportional, const Dividend& fixed) const {
+    // From standard Gaussian get asset endpoint prices
+    std::vector<std::vector<double>> S_path(OneAssetWithPath_BS(option_.S_, Z, schedule).S);
     
-    std::vector<double> time_diff(proportional.dates.size() + fixed.dates.size());
-    std::merge(proportional.dates.cbegin(), proportional.dates.cend(), fixed.dates.cbegin(), fixed.dates.cend(), time_diff.begin());
-    time_diff.push_back(option_.T_);
+    // Same normals without dividends
+    const std::vector<double>& sqrt_of_time_diff = schedule.SqrtTimeDiff();
+    auto ZtoSNoDiv = [&](const std::vector<double>& z_path)->double {
+        return option_.S_ * std::exp((option_.r_ - option_.sigma_ * option_.sigma_ * .5) * option_.T_ + option_.sigma_ * (std::inner_product(z_path.cbegin(), z_path.cend(), sqrt_of_time_diff.cbegin(), 0.)));
+    };
     
-    std::adjacent_difference(time_diff.cbegin(), time_diff.cend(), time_diff.begin());
+    // Get payoff
+    std::vector<double> V(N);
+    std::vector<double> V_nodiv(N);
+    for (std::size_t i = 0; i < N; i++) {
+        V[i] = discount_ * payoff(S_path[i].back());
+        V_nodiv[i] = discount_ * payoff(ZtoSNoDiv(Z[i]));
+    }
     
-    std::transform(time_diff.cbegin(), time_diff.cend(), time_diff.begin(), [](double t)->double { return std::sqrt(t); });
-        
-    return time_diff;
+    return std::vector<std::vector<double>>({V, V_nodiv});
 }
-
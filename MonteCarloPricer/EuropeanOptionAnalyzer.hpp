@@ -11,6 +11,10 @@
 #include "EuropeanOption.hpp"
 #include <iostream>
 #include "PathGenerator.hpp"
+#include "JumpDiffusion.hpp"
+#include "QuantileSketch.hpp"
+#include "ResultCache.hpp"
+#include "ScenarioStore.hpp"
 
 struct EuropeanOptionResults {
     double Call;
@@ -28,10 +32,18 @@ struct EuropeanOptionResults {
 class EuropeanOptionAnalyzer {
 private:
     EuropeanOption option_;
+    double discount_;   // exp(-r T), cached
+    
+    ResultCache* cache_;    // Optional, not owned
+    std::string cache_tag_;
     
 public:
     EuropeanOptionAnalyzer(const EuropeanOption& option);
     
+    // Memoize Price(N, type, modifier, seed) in cache, tagged for invalidation (e.g. with the underlying)
+    // A hit restores the generator state the simulation left, so later draws are the same with or without the cache
+    void UseCache(ResultCache* cache, const std::string& tag = "");
+    
     EuropeanOptionResults Analyze(std::size_t N, unsigned long seed = 1) const;
     
     enum VarRed {
@@ -49,8 +61,29 @@ public:
     
     double Price(std::size_t N, const OptionType& type, const VarRed& modifier = vanilla, unsigned long seed = 1) const;
     
+    // Piecewise rates, dividend yield and volatility, integrated once over [0, T]
+    double Price(std::size_t N, const OptionType& type, const TermStructure& curves, unsigned long seed = 1) const;
+    
+    // Merton jump-diffusion, endpoints only
+    // return: value, value with the Black-Scholes price given each path's jump count as control variate
+    // (its mean is the Merton series price)
+    std::vector<double> Price(std::size_t N, const OptionType& type, const MertonJump& jump, unsigned long seed = 1) const;
+    
+    // Common random numbers from a scenario file: stored normals drive this option's model (summed over the path),
+    // stored paths are priced as they are at their last node, and must come from this option's S0, T, sigma, r and q
+    double Price(const ScenarioStore& store, const OptionType& type) const;
+    
+    // Distribution of the discounted payoff (mean, standard error, quantiles, expected shortfall)
+    // Simulated block_size samples at a time, so memory stays bounded at any N
+    PayoffDistribution PriceDistribution(std::size_t N, const OptionType& type, unsigned long seed = 1, unsigned num_threads = 0, std::size_t block_size = 1 << 20) const;
+    
 private:
+    double PriceUncached(std::size_t N, const OptionType& type, const VarRed& modifier, unsigned long seed) const;
+    
     double DiscountAndAverage(const std::vector<double>& vec) const;
+    // With a discount factor other than exp(-r T) (e.g. TimeGridIntegrals::discount)
+    double DiscountAndAverage(const std::vector<double>& vec, double discount) const;
+    std::vector<double> EvaluatePayoff(const std::vector<double>& S, const std::function<double (double)>& payoff) const;
     
     double PriceVanilla(std::size_t N, const std::function<double (double)>& payoff) const;
     // Control variate
@@ -62,14 +95,15 @@ private:
     // Moment matching and control variables
     double PriceMMCV(std::size_t N, const std::function<double (double)>& payoff) const;
     
-    double ControlVariateCoefficient(const std::vector<double>& dependent_variable, const std::vector<double>& independent_variable) const;
-    
-    std::vector<double> FindSqrtOfTimeDiff(const Dividend& proportional, const Dividend& fixed) const;
-    
 public:
     // Discrete-dividend-paying option
     // return: value, delta, value with control variates, delta with control variates
     std::vector<double> Price(std::size_t N, const std::function<double (double)>& payoff, const Dividend& proportional, const Dividend& fixed, unsigned seed = 1) const;
+    // Same, with a schedule compiled once (with the option's T, sigma and r) and reused across calls
+    std::vector<double> Price(std::size_t N, const std::function<double (double)>& payoff, const DividendSchedule& schedule, unsigned seed = 1) const;
+    // Discounted payoffs of the next N samples and of the same payoff without dividends (control, mean: Put()),
+    // continuing from the current generator state (no reseed)
+    std::vector<std::vector<double>> DiscountedPayoffs(std::size_t N, const std::function<double (double)>& payoff, const DividendSchedule& schedule) const;
     
     
     
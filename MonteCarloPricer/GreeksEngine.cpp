@@ -0,0 +1,99 @@
+//
+//  GreeksEngine.cpp
+//  MonteCarloPricer
+//
+
+#include "GreeksEngine.hpp"
+#include "RNG.hpp"
+#include "PathGenerator.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+GreeksEngine::GreeksEngine(const EuropeanOption& option, const EuropeanOptionType& option_type) : GreeksEngine(option, VanillaOption(option, option_type)) {}
+
+GreeksEngine::GreeksEngine(const EuropeanOption& option, const EuropeanOptionType& option_type, const Dividend& proportional, const Dividend& fixed) : GreeksEngine(option, option_type) {
+    has_dividends_ = true;
+    proportional_ = proportional;
+    fixed_ = fixed;
+}
+
+std::vector<double> GreeksEngine::Revalue(const std::vector<Scenario>& scenarios, std::size_t path_length, std::size_t num_paths, unsigned long seed, std::size_t block_size) const {
+    
+    // Reseed RNG machine
+    LCE_uniform::reseed(seed);
+    
+    // With dividends the nodes are the intervals of the schedule, whatever the bumps
+    if (has_dividends_) path_length = DividendSchedule(option_.T_, option_.sigma_, option_.r_, option_.q_, proportional_, fixed_).Intervals();
+    const std::vector<std::size_t> observed = terminal_only_ ? std::vector<std::size_t>({path_length - 1}) : std::vector<std::size_t>();
+    
+    std::vector<double> sum_V(scenarios.size(), 0.);
+    
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t block_paths = std::min(block_size, num_paths - done);
+        
+        if (has_dividends_) {
+            // Path-major normals, as TradePricer draws them; gen may return one extra path, which is dropped
+            std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(block_paths, path_length));
+            Z.resize(block_paths);
+            
+            for (std::size_t i = 0; i < scenarios.size(); i++) {
+                const Scenario& s = scenarios[i];
+                DividendSchedule schedule(option_.T_, option_.sigma_ + s.dsigma, option_.r_ + s.dr, option_.q_, proportional_, fixed_);
+                OneAssetPathBlock S(option_.S_ + s.dS, OneAssetWithPath_BS(option_.S_ + s.dS, Z, schedule).S);
+                std::vector<double> V(payoff_(S));
+                sum_V[i] += std::accumulate(V.cbegin(), V.cend(), 0.);
+            }
+            continue;
+        }
+        
+        // One buffer of normals (time-major) shared by every scenario
+        // Normals come in pairs: an odd count draws one spare normal, which no path uses
+        const std::size_t size = block_paths * path_length;
+        std::vector<double> Z(StandardGaussianMatrix::gen(size + size % 2));
+        
+        for (std::size_t i = 0; i < scenarios.size(); i++) {
+            const Scenario& s = scenarios[i];
+            OneAssetPathBlock_BS S(option_.S_ + s.dS, option_.T_, option_.sigma_ + s.dsigma, option_.r_ + s.dr, option_.q_, block_paths, path_length, Z.data(), observed);
+            std::vector<double> V(payoff_(S));
+            sum_V[i] += std::accumulate(V.cbegin(), V.cend(), 0.);
+        }
+    }
+    
+    std::vector<double> res(scenarios.size());
+    for (std::size_t i = 0; i < scenarios.size(); i++) {
+        res[i] = sum_V[i] / num_paths * std::exp(-(option_.r_ + scenarios[i].dr) * option_.T_);
+    }
+    return res;
+}
+
+GreeksResults GreeksEngine::Greeks(std::size_t path_length, std::size_t num_paths, double h_S, double h_sigma, double h_r, unsigned long seed) const {
+    
+    const double dS = h_S * option_.S_;
+    
+    std::vector<Scenario> scenarios({
+        {0., 0., 0.},
+        {dS, 0., 0.},
+        {-dS, 0., 0.},
+        {0., h_sigma, 0.},
+        {0., -h_sigma, 0.},
+        {0., 0., h_r},
+        {0., 0., -h_r},
+        {dS, h_sigma, 0.},
+        {dS, -h_sigma, 0.},
+        {-dS, h_sigma, 0.},
+        {-dS, -h_sigma, 0.},
+    });
+    
+    std::vector<double> V(this->Revalue(scenarios, path_length, num_paths, seed));
+    
+    GreeksResults res;
+    res.Price = V[0];
+    res.Delta = (V[1] - V[2]) / (2. * dS);
+    res.Gamma = (V[1] - 2. * V[0] + V[2]) / (dS * dS);
+    res.Vega = (V[3] - V[4]) / (2. * h_sigma);
+    res.Rho = (V[5] - V[6]) / (2. * h_r);
+    res.Vanna = (V[7] - V[8] - V[9] + V[10]) / (4. * dS * h_sigma);
+    
+    return res;
+}
@@ -0,0 +1,67 @@
+//
+//  GreeksEngine.hpp
+//  MonteCarloPricer
+//
+
+#ifndef GreeksEngine_hpp
+#define GreeksEngine_hpp
+
+#include <functional>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+#include "EuropeanOption.hpp"
+#include "PathDependentOption.hpp"
+#include "PathGenerator.hpp"
+
+struct Scenario {
+    double dS;      // Spot bump
+    double dsigma;  // Volatility bump
+    double dr;      // Interest rate bump
+};
+
+struct GreeksResults {
+    double Price;
+    double Delta;
+    double Gamma;
+    double Vega;
+    double Rho;
+    double Vanna;
+    
+    void Print() const {
+        std::cout << Price << '\t' << Delta << '\t' << Gamma << '\t' << Vega << '\t' << Rho << '\t' << Vanna << std::endl;
+    }
+};
+
+class GreeksEngine {
+    // Bump-and-revalue under Black-Scholes with common random numbers
+    // Normals are drawn once per block of paths and kept in a buffer; every scenario is revalued on that
+    // block before the next one is drawn, so a full set of Greeks costs the RNG work of one price
+    // With discrete dividends (vanilla payoffs only) each path has one node per interval between dividends,
+    // and every scenario rebuilds the schedule with its bumped vol and rate; q stays on top of the dividends
+private:
+    EuropeanOption option_;     // Base parameters
+    std::function<std::vector<double> (const OneAssetPathBlock&)> payoff_;
+    bool terminal_only_;        // Only the last node is needed
+    bool has_dividends_;
+    Dividend proportional_;
+    Dividend fixed_;
+    
+public:
+    // Path-dependent payoff, copied; Asian averages start from the (bumped) spot of the block
+    template <class Payoff, std::enable_if_t<std::is_base_of_v<PathDependentOption, Payoff>, int> = 0>
+    GreeksEngine(const EuropeanOption& option, const Payoff& payoff) : option_(option), payoff_([payoff](const OneAssetPathBlock& block) { return payoff(block); }), terminal_only_(payoff.TerminalOnly()), has_dividends_(false) {}
+    // Vanilla payoff on the terminal price
+    GreeksEngine(const EuropeanOption& option, const EuropeanOptionType& option_type);
+    // Vanilla payoff under proportional and fixed discrete dividends (dates sorted, inside (0, T))
+    GreeksEngine(const EuropeanOption& option, const EuropeanOptionType& option_type, const Dividend& proportional, const Dividend& fixed);
+    ~GreeksEngine() = default;
+    
+    // Discounted price under every scenario; with dividends, path_length is ignored
+    std::vector<double> Revalue(const std::vector<Scenario>& scenarios, std::size_t path_length, std::size_t num_paths, unsigned long seed = 1, std::size_t block_size = 8192) const;
+    
+    // Central differences with relative spot bump h_S, absolute vol bump h_sigma and rate bump h_r
+    GreeksResults Greeks(std::size_t path_length, std::size_t num_paths, double h_S = .01, double h_sigma = .01, double h_r = .0001, unsigned long seed = 1) const;
+};
+
+#endif /* GreeksEngine_hpp */
@@ -0,0 +1,89 @@
+//
+//  HestonModel.cpp
+//  MonteCarloPricer
+//
+
+#include "HestonModel.hpp"
+#include "Instrumentation.hpp"
+#include "VectorMath.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+OneAssetPathBlock_Heston::OneAssetPathBlock_Heston(double S0, double T, double r, double q, const HestonParameters& heston, std::size_t num_paths, std::size_t path_length, const std::vector<double>& z) : OneAssetPathBlock(S0, num_paths, path_length) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    assert(z.size() == 2 * path_length * num_paths);
+    
+    const double kappa = heston.kappa;
+    const double theta = heston.theta;
+    const double xi = heston.xi;
+    const double rho = heston.rho;
+    
+    const double dt = T / path_length;
+    
+    // Constants of the variance moments
+    const double E = std::exp(-kappa * dt);
+    const double c1 = xi * xi * E * (1. - E) / kappa;
+    const double c2 = theta * xi * xi * (1. - E) * (1. - E) / (2. * kappa);
+    
+    // Switching level between the quadratic and exponential branches
+    constexpr double psi_c = 1.5;
+    
+    // Log-spot discretization, central weights gamma1 = gamma2 = 1/2
+    const double K0 = -rho * kappa * theta * dt / xi;
+    const double K1 = .5 * dt * (kappa * rho / xi - .5) - rho / xi;
+    const double K2 = .5 * dt * (kappa * rho / xi - .5) + rho / xi;
+    const double K3 = .5 * dt * (1. - rho * rho);
+    const double K4 = K3;
+    const double A = K2 + .5 * K4;
+    const double carry = (r - q) * dt;
+    
+    std::vector<double> v(num_paths, heston.v0);
+    std::vector<double> log_S(num_paths, std::log(S0));
+    
+    for (std::size_t t = 0; t < path_length; t++) {
+        const double* z_v = z.data() + (2 * t) * num_paths;
+        const double* z_s = z.data() + (2 * t + 1) * num_paths;
+        
+        for (std::size_t p = 0; p < num_paths; p++) {
+            const double v_t = v[p];
+            
+            const double m = theta + (v_t - theta) * E;
+            const double s2 = v_t * c1 + c2;
+            const double psi = s2 / (m * m);
+            
+            // Quadratic branch: v' = a (b + Z)^2
+            const double inv_psi = 2. / psi;
+            const double b2 = inv_psi - 1. + std::sqrt(inv_psi) * std::sqrt(std::max(inv_psi - 1., 0.));
+            const double a = m / (1. + b2);
+            const double b = std::sqrt(b2);
+            const double v_quadratic = a * (b + z_v[p]) * (b + z_v[p]);
+            
+            // Exponential branch: point mass at 0 with probability P, exponential tail otherwise
+            // The uniform is taken from the same normal, U = Phi(Z)
+            const double P = (psi - 1.) / (psi + 1.);
+            const double beta = (1. - P) / m;
+            const double U = .5 * std::erfc(-z_v[p] / std::sqrt(2.));
+            const double v_exponential = std::log(std::max((1. - P) / (1. - U), 1.)) / beta;
+            
+            const bool is_quadratic = psi <= psi_c;
+            const double v_next = is_quadratic ? v_quadratic : v_exponential;
+            
+            // Martingale correction: K0* = -log E[exp(A v')] - (K1 + K3 / 2) v
+            // Falls back to the uncorrected K0 where the moment generating function does not exist
+            const double one_minus_2Aa = 1. - 2. * A * a;
+            const double log_M_quadratic = A * b2 * a / one_minus_2Aa - .5 * std::log(std::max(one_minus_2Aa, 1e-300));
+            const double log_M_exponential = std::log(std::max(P + beta * (1. - P) / (beta - A), 1e-300));
+            const bool has_mgf = is_quadratic ? (one_minus_2Aa > 0.) : (beta > A);
+            const double K0_star = has_mgf ? -(is_quadratic ? log_M_quadratic : log_M_exponential) - (K1 + .5 * K3) * v_t : K0;
+            
+            log_S[p] += carry + K0_star + K1 * v_t + K2 * v_next + std::sqrt(K3 * v_t + K4 * v_next) * z_s[p];
+            v[p] = v_next;
+        }
+        
+        std::copy(log_S.cbegin(), log_S.cend(), this->Step(t));
+    }
+    
+    VectorMath::Exp(S);
+}
@@ -0,0 +1,32 @@
+//
+//  HestonModel.hpp
+//  MonteCarloPricer
+//
+
+#ifndef HestonModel_hpp
+#define HestonModel_hpp
+
+#include <vector>
+#include "PathGenerator.hpp"
+
+struct HestonParameters {
+    double v0;      // Initial variance
+    double kappa;   // Mean reversion speed
+    double theta;   // Long-run variance
+    double xi;      // Volatility of variance
+    double rho;     // Correlation between spot and variance
+};
+
+class OneAssetPathBlock_Heston : public OneAssetPathBlock {
+    // One asset
+    // The whole paths are generated, stored time-major
+    // Heston stochastic volatility model, Andersen's quadratic-exponential (QE) scheme with martingale correction
+    // Both QE branches are evaluated and selected per lane, so the step loop has no data-dependent branches
+public:
+    // z: 2 standard normals per path and step, time-major
+    // z[(2 * t) * num_paths + p] drives the variance, z[(2 * t + 1) * num_paths + p] the spot
+    OneAssetPathBlock_Heston(double S0, double T, double r, double q, const HestonParameters& heston, std::size_t num_paths, std::size_t path_length, const std::vector<double>& z);
+    ~OneAssetPathBlock_Heston() = default;
+};
+
+#endif /* HestonModel_hpp */
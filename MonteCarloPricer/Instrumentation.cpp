@@ -0,0 +1,70 @@
+//
+//  Instrumentation.cpp
+//  MonteCarloPricer
+//
+
+#include "Instrumentation.hpp"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct ThreadReport;
+
+// Live per-thread reports, and the total of the threads that have exited
+std::mutex registry_mutex;
+std::vector<ThreadReport*> registry;
+InstrumentationReport retired;
+
+struct ThreadReport {
+    InstrumentationReport report;
+    int depth[NumStages] = {};
+    
+    ThreadReport() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(this);
+    }
+    
+    ~ThreadReport() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        retired.Merge(report);
+        registry.erase(std::find(registry.begin(), registry.end(), this));
+    }
+};
+
+ThreadReport& Local() {
+    static thread_local ThreadReport local;
+    return local;
+}
+
+}
+
+void Instrumentation::Reset() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (ThreadReport* thread : registry) {
+        thread->report = InstrumentationReport();
+    }
+    retired = InstrumentationReport();
+}
+
+InstrumentationReport Instrumentation::Report() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    InstrumentationReport res = retired;
+    for (const ThreadReport* thread : registry) {
+        res.Merge(thread->report);
+    }
+    return res;
+}
+
+void Instrumentation::AddTime(InstrumentationStage stage, double seconds) {
+    Local().report.seconds[stage] += seconds;
+}
+
+void Instrumentation::Count(InstrumentationCounter counter, unsigned long long n) {
+    Local().report.counts[counter] += n;
+}
+
+int& Instrumentation::Depth(InstrumentationStage stage) {
+    return Local().depth[stage];
+}
@@ -0,0 +1,108 @@
+//
+//  Instrumentation.hpp
+//  MonteCarloPricer
+//
+
+#ifndef Instrumentation_hpp
+#define Instrumentation_hpp
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+
+// Opt-in: build with -DMCP_INSTRUMENTATION to enable.
+// Otherwise MCP_TIME_STAGE and MCP_COUNT expand to nothing and the hot paths carry no instrumentation at all.
+
+enum InstrumentationStage {
+    StageRNG,           // Drawing normals
+    StagePathBuild,     // Path generator constructors
+    StagePayoff,        // Payoff evaluation
+    StageReduction,     // Discounting, averaging, estimators
+    NumStages,
+};
+
+enum InstrumentationCounter {
+    CountNormalsDrawn,
+    CountMarsagliaBrayRejections,
+    CountRejectionRejections,   // Rejection::standard_normal
+    CountPathsKnockedOut,       // Barrier paths paying nothing because of the barrier
+    CountBytesAllocated,        // Normals and path storage
+    NumCounters,
+};
+
+struct InstrumentationReport {
+    double seconds[NumStages] = {};
+    unsigned long long counts[NumCounters] = {};
+    
+    void Merge(const InstrumentationReport& other) {
+        for (int i = 0; i < NumStages; i++) seconds[i] += other.seconds[i];
+        for (int i = 0; i < NumCounters; i++) counts[i] += other.counts[i];
+    }
+    
+    void Print() const {
+        std::cout << "rng " << seconds[StageRNG] << "s\tpath " << seconds[StagePathBuild] << "s\tpayoff " << seconds[StagePayoff] << "s\treduction " << seconds[StageReduction] << 's' << std::endl;
+        std::cout << "normals " << counts[CountNormalsDrawn] << "\tMarsaglia-Bray rejections " << counts[CountMarsagliaBrayRejections] << "\trejection-sampler rejections " << counts[CountRejectionRejections] << "\tknocked out " << counts[CountPathsKnockedOut] << "\tbytes " << counts[CountBytesAllocated] << std::endl;
+    }
+};
+
+class Instrumentation {
+    // Every thread accumulates into its own report without synchronization; reports of finished threads are folded
+    // into a shared total. Reset() and Report() cover all threads, and are meant to be called while no pricing runs.
+public:
+    // No instances of Instrumentation is needed.
+    Instrumentation() = delete;
+    ~Instrumentation() = default;
+    
+    static constexpr bool enabled =
+#ifdef MCP_INSTRUMENTATION
+        true;
+#else
+        false;
+#endif
+    
+    static void Reset();
+    static InstrumentationReport Report();
+    
+    static void AddTime(InstrumentationStage stage, double seconds);
+    static void Count(InstrumentationCounter counter, unsigned long long n = 1);
+    
+    // Nesting depth of a stage on this thread: only the outermost timer of a stage records
+    static int& Depth(InstrumentationStage stage);
+};
+
+class ScopedStageTimer {
+    // steady_clock timer charging its scope to one stage
+private:
+    InstrumentationStage stage_;
+    bool outermost_;
+    std::chrono::steady_clock::time_point start_;
+    
+public:
+    ScopedStageTimer(InstrumentationStage stage) : stage_(stage), outermost_(Instrumentation::Depth(stage)++ == 0), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedStageTimer() {
+        if (outermost_) Instrumentation::AddTime(stage_, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+        Instrumentation::Depth(stage_)--;
+    }
+};
+
+#define MCP_CONCAT_IMPL(a, b) a##b
+#define MCP_CONCAT(a, b) MCP_CONCAT_IMPL(a, b)
+
+#ifdef MCP_INSTRUMENTATION
+#define MCP_TIME_STAGE(stage) ScopedStageTimer MCP_CONCAT(mcp_stage_timer_, __LINE__)(stage)
+#define MCP_COUNT(counter, n) Instrumentation::Count(counter, n)
+#else
+#define MCP_TIME_STAGE(stage)
+#define MCP_COUNT(counter, n)
+#endif
+
+// Runs f on a clean slate and returns its result with the report of everything it did (empty when disabled)
+template <typename F>
+auto Instrumented(F f) -> std::pair<decltype(f()), InstrumentationReport> {
+    Instrumentation::Reset();
+    auto result = f();
+    return std::make_pair(std::move(result), Instrumentation::Report());
+}
+
+#endif /* Instrumentation_hpp */
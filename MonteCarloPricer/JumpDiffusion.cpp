@@ -0,0 +1,142 @@
+//
+//  JumpDiffusion.cpp
+//  MonteCarloPricer
+//
+
+#include "JumpDiffusion.hpp"
+#include "Instrumentation.hpp"
+#include "RNG.hpp"
+#include "VectorMath.hpp"
+#include <algorithm>
+#include <cmath>
+
+double MertonJump::Compensator() const {
+    return std::exp(mu + delta * delta / 2.) - 1.;
+}
+
+double MertonJump::EuropeanPrice(const EuropeanOption& option, const EuropeanOptionType& option_type) const {
+    // V = sum_n exp(-lambda' T) (lambda' T)^n / n! * BS(sigma_n, r_n)
+    // lambda' = lambda (1 + k), sigma_n^2 = sigma^2 + n delta^2 / tau, r_n = r - lambda k + n log(1 + k) / tau
+    const double tau = option.T_ - option.t_;
+    const double k = this->Compensator();
+    const double mean = lambda * (1. + k) * tau;
+    
+    // Weights in log space: exp(-mean) alone underflows once mean passes about 745.
+    // The terms within 40 standard deviations of the mean carry all the weight, so the series starts there
+    // and stops there at the latest, even if rounding keeps the cumulative weight short of 1.
+    auto weight = [mean](unsigned n)->double {
+        return (n == 0) ? std::exp(-mean) : std::exp(n * std::log(mean) - mean - std::lgamma(n + 1.));
+    };
+    const unsigned first = static_cast<unsigned>(std::max(0., std::floor(mean - 40. * std::sqrt(mean))));
+    const unsigned last = static_cast<unsigned>(std::ceil(mean + 40. * std::sqrt(mean))) + 50;
+    
+    double cumulative = 0.;
+    double V = 0.;
+    for (unsigned n = first; (n <= last) && ((n < first + 50) || (1. - cumulative > 1e-14)); n++) {
+        const double w = weight(n);
+        double sigma_n = std::sqrt(option.sigma_ * option.sigma_ + n * delta * delta / tau);
+        double r_n = option.r_ - lambda * k + n * std::log(1. + k) / tau;
+        EuropeanOption option_n(option.t_, option.S_, option.K_, option.T_, sigma_n, r_n, option.q_);
+        
+        V += w * ((option_type == Call) ? option_n.Call() : option_n.Put());
+        cumulative += w;
+    }
+    
+    return V;
+}
+
+PoissonSampler::PoissonSampler(double mean) : first_(0) {
+    if (mean <= 0.) return;
+    
+    // Probabilities in log space, as in MertonJump::EuropeanPrice: exp(-mean) alone underflows once mean passes about 745.
+    // The table starts 40 standard deviations below the mean; nothing below carries any weight.
+    first_ = static_cast<unsigned>(std::max(0., std::floor(mean - 40. * std::sqrt(mean))));
+    const double log_mean = std::log(mean);
+    double cumulative = 0.;
+    for (unsigned n = first_; ; n++) {
+        const double p = std::exp(n * log_mean - mean - std::lgamma(n + 1.));
+        cumulative += p;
+        if (cumulative >= 1. - 1e-16 || (p == 0. && n > mean)) break;
+        cdf_.push_back(cumulative);
+    }
+}
+
+std::vector<unsigned> PoissonSampler::operator () (const std::vector<double>& u) const {
+    std::vector<unsigned> count(u.size(), first_);
+    
+    // One pass over the table per batch; the inner loop vectorizes
+    for (double c : cdf_) {
+        for (std::size_t i = 0; i < u.size(); i++) {
+            count[i] += (u[i] > c);
+        }
+    }
+    
+    return count;
+}
+
+OneAssetNoPath_Merton::OneAssetNoPath_Merton(double S0, double T, double sigma, double r, double q, const MertonJump& jump, const std::vector<double>& z_arr) : OneAssetNoPath(z_arr.size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const std::size_t N = z_arr.size();
+    
+    // Batched jump counts
+    std::vector<double> u(N);
+    for (double& x : u) {
+        x = LCE_uniform::gen();
+    }
+    jumps = PoissonSampler(jump.lambda * T)(u);
+    const std::vector<unsigned>& n = jumps;
+    
+    // The sum of n log jumps is N(n mu, n delta^2)
+    std::vector<double> z_jump(StandardGaussianMatrix::gen(N + N % 2));
+    
+    const double drift = std::log(S0) + (r - q - jump.lambda * jump.Compensator() - sigma * sigma / 2.) * T;
+    const double vol = sigma * std::sqrt(T);
+    for (std::size_t i = 0; i < N; i++) {
+        S[i] = drift + vol * z_arr[i] + n[i] * jump.mu + std::sqrt(double(n[i])) * jump.delta * z_jump[i];
+    }
+    
+    VectorMath::Exp(S);
+}
+
+OneAssetPathBlock_Merton::OneAssetPathBlock_Merton(double S0, double T, double sigma, double r, double q, const MertonJump& jump, const std::vector<std::vector<double>>& z_arr) : OneAssetPathBlock(S0, z_arr.size(), z_arr[0].size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const double dt = T / path_length;
+    
+    // Batched jump counts
+    std::vector<double> u(num_paths);
+    for (double& x : u) {
+        x = LCE_uniform::gen();
+    }
+    std::vector<unsigned> n(PoissonSampler(jump.lambda * T)(u));
+    std::size_t total_jumps = 0;
+    for (unsigned n_p : n) {
+        total_jumps += n_p;
+    }
+    
+    // Pre-sample jump times (uniform on [0, T]) and sizes into a time-major table of log jumps
+    std::vector<double> log_jump(num_paths * path_length, 0.);
+    std::vector<double> z_jump(StandardGaussianMatrix::gen(total_jumps + total_jumps % 2));
+    auto z_jump_it = z_jump.cbegin();
+    for (std::size_t p = 0; p < num_paths; p++) {
+        for (unsigned j = 0; j < n[p]; j++) {
+            std::size_t t = std::min(static_cast<std::size_t>(LCE_uniform::gen() * path_length), path_length - 1);
+            log_jump[t * num_paths + p] += jump.mu + jump.delta * *(z_jump_it++);
+        }
+    }
+    
+    // Diffusion, with the jumps added as one more increment
+    const double drift = (r - q - jump.lambda * jump.Compensator() - sigma * sigma / 2.) * dt;
+    const double vol = sigma * std::sqrt(dt);
+    std::vector<double> log_S(num_paths, std::log(S0));
+    for (std::size_t t = 0; t < path_length; t++) {
+        const double* J = log_jump.data() + t * num_paths;
+        for (std::size_t p = 0; p < num_paths; p++) {
+            log_S[p] += drift + vol * z_arr[p][t] + J[p];
+        }
+        std::copy(log_S.cbegin(), log_S.cend(), this->Step(t));
+    }
+    
+    VectorMath::Exp(S);
+}
@@ -0,0 +1,64 @@
+//
+//  JumpDiffusion.hpp
+//  MonteCarloPricer
+//
+
+#ifndef JumpDiffusion_hpp
+#define JumpDiffusion_hpp
+
+#include <vector>
+#include "EuropeanOption.hpp"
+#include "PathGenerator.hpp"
+
+struct MertonJump {
+    double lambda;  // Jump intensity
+    double mu;      // Mean of log jump size
+    double delta;   // Stdev of log jump size
+    
+    // E[J - 1], used to compensate the drift
+    double Compensator() const;
+    
+    // Semi-closed-form price as a Poisson-weighted series of Black-Scholes prices
+    double EuropeanPrice(const EuropeanOption& option, const EuropeanOptionType& option_type) const;
+};
+
+class PoissonSampler {
+    // Inverse-transform sampling of Poisson(mean) through a precomputed CDF table
+    // A whole batch of uniforms is mapped at once: count = first + #{table entries < u}
+private:
+    unsigned first_;            // Counts below it have negligible probability and are not tabulated
+    std::vector<double> cdf_;   // CDF at first, first + 1, ...
+    
+public:
+    PoissonSampler(double mean);
+    ~PoissonSampler() = default;
+    
+    std::vector<unsigned> operator () (const std::vector<double>& u) const;
+};
+
+class OneAssetNoPath_Merton : public OneAssetNoPath {
+    // One asset
+    // Only endpoints are generated
+    // Merton jump-diffusion: the jump count of every path is drawn in one batched Poisson step,
+    // and the sum of n log-normal jumps is drawn as a single normal
+    // Jump randomness is drawn from LCE_uniform after z_arr
+public:
+    std::vector<unsigned> jumps;    // Jump count of each path
+    
+    OneAssetNoPath_Merton(double S0, double T, double sigma, double r, double q, const MertonJump& jump, const std::vector<double>& z_arr);
+    ~OneAssetNoPath_Merton() = default;
+};
+
+class OneAssetPathBlock_Merton : public OneAssetPathBlock {
+    // One asset
+    // The whole paths are generated, stored time-major
+    // Merton jump-diffusion: jump times and sizes are pre-sampled into a time-major table of log jumps,
+    // so the diffusion step is the same branch-free loop as OneAssetPathBlock_BS
+    // Jump randomness is drawn from LCE_uniform after z_arr
+public:
+    // Path-major normals, one std::vector per path (as from StandardGaussianMatrix::gen(num_paths, path_length))
+    OneAssetPathBlock_Merton(double S0, double T, double sigma, double r, double q, const MertonJump& jump, const std::vector<std::vector<double>>& z_arr);
+    ~OneAssetPathBlock_Merton() = default;
+};
+
+#endif /* JumpDiffusion_hpp */
@@ -0,0 +1,91 @@
+//
+//  LocalVolatility.cpp
+//  MonteCarloPricer
+//
+
+#include "LocalVolatility.hpp"
+#include "Instrumentation.hpp"
+#include "VectorMath.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+LocalVolSurface::LocalVolSurface(const std::function<double (double, double)>& local_vol) : local_vol_(local_vol) {}
+
+LocalVolSurface LocalVolSurface::FromImpliedVol(const std::function<double (double, double)>& implied_vol, double S0, double r, double q) {
+    
+    // Dupire in total implied variance w(T, y) = sigma_imp^2 T, y = log(K / F_T):
+    // sigma_loc^2 = w_T / (1 - y / w * w_y + (-1/4 - 1/w + y^2 / w^2) * w_y^2 / 4 + w_yy / 2)
+    auto w = [=](double T, double y)->double {
+        double K = S0 * std::exp((r - q) * T + y);
+        double sigma = implied_vol(T, K);
+        return sigma * sigma * T;
+    };
+    
+    return LocalVolSurface([=](double t, double S)->double {
+        constexpr double h_T = 1e-4;
+        constexpr double h_y = 1e-3;
+        
+        double T = std::max(t, 2. * h_T);
+        double y = std::log(S / S0) - (r - q) * T;
+        
+        double w0 = w(T, y);
+        double w_T = (w(T + h_T, y) - w(T - h_T, y)) / (2. * h_T);
+        double w_up = w(T, y + h_y);
+        double w_down = w(T, y - h_y);
+        double w_y = (w_up - w_down) / (2. * h_y);
+        double w_yy = (w_up - 2. * w0 + w_down) / (h_y * h_y);
+        
+        double denominator = 1. - y / w0 * w_y + .25 * (-.25 - 1. / w0 + y * y / (w0 * w0)) * w_y * w_y + .5 * w_yy;
+        double variance = w_T / std::max(denominator, 1e-8);
+        
+        return std::sqrt(std::max(variance, 1e-8));
+    });
+}
+
+double LocalVolSurface::operator () (double t, double S) const {
+    return local_vol_(t, S);
+}
+
+LocalVolGrid::LocalVolGrid(const LocalVolSurface& surface, double S0, double T, std::size_t path_length, std::size_t num_nodes, double width_in_stdevs) : path_length(path_length), dt(T / path_length), num_nodes(num_nodes), sigma(path_length * num_nodes), slope(path_length * num_nodes) {
+    
+    assert(num_nodes >= 2);
+    
+    double width = std::max(width_in_stdevs * surface(0., S0) * std::sqrt(T), .5);
+    x_min = std::log(S0) - width;
+    double dx = 2. * width / (num_nodes - 1);
+    inv_dx = 1. / dx;
+    
+    for (std::size_t t = 0; t < path_length; t++) {
+        double* sigma_t = sigma.data() + t * num_nodes;
+        double* slope_t = slope.data() + t * num_nodes;
+        for (std::size_t j = 0; j < num_nodes; j++) {
+            sigma_t[j] = surface(t * dt, std::exp(x_min + j * dx));
+        }
+        for (std::size_t j = 0; j + 1 < num_nodes; j++) {
+            slope_t[j] = sigma_t[j + 1] - sigma_t[j];
+        }
+        slope_t[num_nodes - 1] = 0.;
+    }
+}
+
+OneAssetPathBlock_LocalVol::OneAssetPathBlock_LocalVol(double S0, double r, double q, const LocalVolGrid& grid, const std::vector<std::vector<double>>& z_arr) : OneAssetPathBlock(S0, z_arr.size(), z_arr[0].size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    assert(path_length == grid.path_length);
+    
+    const double carry = (r - q) * grid.dt;
+    const double sqrt_dt = std::sqrt(grid.dt);
+    
+    std::vector<double> log_S(num_paths, std::log(S0));
+    
+    for (std::size_t t = 0; t < path_length; t++) {
+        for (std::size_t p = 0; p < num_paths; p++) {
+            const double sigma = grid(t, log_S[p]);
+            log_S[p] += carry - .5 * sigma * sigma * grid.dt + sigma * sqrt_dt * z_arr[p][t];
+        }
+        std::copy(log_S.cbegin(), log_S.cend(), this->Step(t));
+    }
+    
+    VectorMath::Exp(S);
+}
@@ -0,0 +1,67 @@
+//
+//  LocalVolatility.hpp
+//  MonteCarloPricer
+//
+
+#ifndef LocalVolatility_hpp
+#define LocalVolatility_hpp
+
+#include <functional>
+#include <vector>
+#include "PathGenerator.hpp"
+
+class LocalVolSurface {
+    // Local volatility sigma(t, S)
+    // Either given directly, or obtained from an implied-vol surface sigma_imp(T, K) with Dupire's formula
+    // Evaluating it is expensive; simulations should go through a LocalVolGrid
+private:
+    std::function<double (double, double)> local_vol_;
+    
+public:
+    LocalVolSurface(const std::function<double (double, double)>& local_vol);
+    ~LocalVolSurface() = default;
+    
+    static LocalVolSurface FromImpliedVol(const std::function<double (double, double)>& implied_vol, double S0, double r, double q);
+    
+    double operator () (double t, double S) const;
+};
+
+class LocalVolGrid {
+    // A local-vol surface tabulated once on a simulation time grid
+    // For each step, sigma is stored on a uniform grid in log-spot and read by a clamped linear table lookup
+public:
+    std::size_t path_length;
+    double dt;
+    std::size_t num_nodes;
+    double x_min;       // Log-spot of the first node
+    double inv_dx;      // 1 / node spacing
+    std::vector<double> sigma;  // sigma[t * num_nodes + j]
+    std::vector<double> slope;  // sigma[.. j + 1] - sigma[.. j]
+    
+    // Nodes cover log(S0) +- width_in_stdevs * sigma(0, S0) * sqrt(T); sigma is flat beyond
+    LocalVolGrid(const LocalVolSurface& surface, double S0, double T, std::size_t path_length, std::size_t num_nodes = 256, double width_in_stdevs = 6.);
+    ~LocalVolGrid() = default;
+    
+    // sigma over step t at log-spot x
+    double operator () (std::size_t t, double x) const {
+        double u = (x - x_min) * inv_dx;
+        u = (u < 0.) ? 0. : u;
+        u = (u > num_nodes - 1.) ? num_nodes - 1. : u;
+        std::size_t j = static_cast<std::size_t>(u);
+        j = (j > num_nodes - 2) ? num_nodes - 2 : j;
+        const std::size_t i = t * num_nodes + j;
+        return sigma[i] + slope[i] * (u - j);
+    }
+};
+
+class OneAssetPathBlock_LocalVol : public OneAssetPathBlock {
+    // One asset
+    // The whole paths are generated, stored time-major
+    // Local volatility model, log-Euler scheme with sigma read from a LocalVolGrid
+public:
+    // Path-major normals, one std::vector per path (as from StandardGaussianMatrix::gen(num_paths, path_length))
+    OneAssetPathBlock_LocalVol(double S0, double r, double q, const LocalVolGrid& grid, const std::vector<std::vector<double>>& z_arr);
+    ~OneAssetPathBlock_LocalVol() = default;
+};
+
+#endif /* LocalVolatility_hpp */
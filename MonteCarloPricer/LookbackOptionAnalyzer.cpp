@@ -0,0 +1,83 @@
+//
+//  LookbackOptionAnalyzer.cpp
+//  MonteCarloPricer
+//
+
+#include "LookbackOptionAnalyzer.hpp"
+#include "Instrumentation.hpp"
+#include "RNG.hpp"
+#include "PathGenerator.hpp"
+#include "ControlVariateEstimator.hpp"
+#include <cmath>
+#include <numeric>
+
+LookbackOptionAnalyzer::LookbackOptionAnalyzer(const LookbackOption& lookback_option) : lookback_option_(lookback_option), option_(lookback_option_.GetVanillaOption()), discount_(std::exp(-option_.r_ * option_.T_)) {}
+
+double LookbackOptionAnalyzer::DiscountAndAverage(const std::vector<double>& vec) const {
+    MCP_TIME_STAGE(StageReduction);
+    double res = std::accumulate(vec.cbegin(), vec.cend(), 0.);
+    res /= vec.size();
+    res *= discount_;
+    return res;
+}
+
+double LookbackOptionAnalyzer::Price(std::size_t path_length, std::size_t num_paths, unsigned seed) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    
+    // From standard Gaussian get asset paths, stored time-major
+    OneAssetPathBlock_BS S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z);
+    
+    // Get payoff
+    std::vector<double> V(lookback_option_(S));
+    
+    return this->DiscountAndAverage(V);
+}
+
+double LookbackOptionAnalyzer::PriceContinuous(std::size_t path_length, std::size_t num_paths, unsigned seed) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    
+    // Asset paths and the extreme of every interval
+    OneAssetExtremeBlock_BS S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z, lookback_option_.UsesMaximum());
+    
+    // Get payoff from the sampled extremes
+    std::vector<double> V(lookback_option_(S));
+    
+    return this->DiscountAndAverage(V);
+}
+
+std::vector<double> LookbackOptionAnalyzer::PriceCV(std::size_t path_length, std::size_t num_paths, unsigned seed) const {
+    
+    // Reseed generator
+    LCE_uniform::reseed(seed);
+    
+    // Generate vector of standard Gaussian
+    std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    
+    // Asset paths and the extreme of every interval
+    OneAssetExtremeBlock_BS S(option_.S_, option_.T_, option_.sigma_, option_.r_, option_.q_, Z, lookback_option_.UsesMaximum());
+    
+    // Get payoff: discrete from the nodes, continuous from the sampled extremes
+    std::vector<double> V(lookback_option_(static_cast<const OneAssetPathBlock&>(S)));
+    std::vector<double> V_continuous(lookback_option_(S));
+    
+    double value = this->DiscountAndAverage(V);
+    
+    for (std::size_t p = 0; p < S.num_paths; p++) {
+        V[p] *= discount_;
+        V_continuous[p] *= discount_;
+    }
+    
+    double W_hat = ControlVariateEstimator::Accumulate(V, {V_continuous}, {lookback_option_.BSPrice()}).Estimate().value;
+    
+    return std::vector<double>({value, W_hat});
+}
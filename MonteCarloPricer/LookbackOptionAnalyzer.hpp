@@ -0,0 +1,33 @@
+//
+//  LookbackOptionAnalyzer.hpp
+//  MonteCarloPricer
+//
+
+#ifndef LookbackOptionAnalyzer_hpp
+#define LookbackOptionAnalyzer_hpp
+
+#include "PathDependentOption.hpp"
+
+class LookbackOptionAnalyzer {
+private:
+    LookbackOption lookback_option_;
+    EuropeanOption option_;
+    double discount_;   // exp(-r T), cached
+    
+public:
+    LookbackOptionAnalyzer(const LookbackOption& lookback_option);
+    
+    // Discrete monitoring at path_length nodes
+    double Price(std::size_t path_length, std::size_t num_paths, unsigned seed = 1) const;
+    
+    // Continuous monitoring: interval extremes sampled along the Brownian bridge, unbiased on any grid
+    double PriceContinuous(std::size_t path_length, std::size_t num_paths, unsigned seed = 1) const;
+    
+    // Discrete monitoring, with the continuous payoff on the same paths as control variate (mean: BSPrice)
+    // return: value, value with control variate
+    std::vector<double> PriceCV(std::size_t path_length, std::size_t num_paths, unsigned seed = 1) const;
+    
+    double DiscountAndAverage(const std::vector<double>& vec) const;
+};
+
+#endif /* LookbackOptionAnalyzer_hpp */
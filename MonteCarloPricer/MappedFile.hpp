@@ -0,0 +1,28 @@
+//
+//  MappedFile.hpp
+//  MonteCarloPricer
+//
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <string>
+#include <string_view>
+
+class MappedFile {
+    // Read-only memory mapping of a whole file (POSIX mmap)
+    // Pages come from the page cache, so processes mapping the same file share one copy
+private:
+    const char* data_;
+    std::size_t size_;
+    
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+    ~MappedFile();
+    
+    std::string_view View() const { return std::string_view(data_, size_); }
+};
+
+#endif /* MappedFile_hpp */
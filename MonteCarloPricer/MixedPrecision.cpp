@@ -0,0 +1,47 @@
+//
+//  MixedPrecision.cpp
+//  MonteCarloPricer
+//
+
+#include "MixedPrecision.hpp"
+#include "Statistics.hpp"
+
+std::vector<PrecisionEstimate> MixedPrecision::Validate(const BarrierOption& option, std::size_t path_length, std::size_t num_paths, unsigned long seed, std::size_t block_size) {
+    const EuropeanOption vanilla = option.GetVanillaOption();
+    const double discount = std::exp(-vanilla.r_ * vanilla.T_);
+    std::vector<PrecisionEstimate> res;
+    
+    // Reference: the double path as TradePricer runs it
+    {
+        const auto start = std::chrono::steady_clock::now();
+        double kernel_seconds = 0.;
+        
+        LCE_uniform::reseed(seed);
+        RunningStatistics stats;
+        for (std::size_t done = 0; done < num_paths; done += block_size) {
+            const std::size_t n = std::min(block_size, num_paths - done);
+            const std::size_t size = n * path_length;
+            const std::vector<double> Z(StandardGaussianMatrix::gen(size + size % 2));
+            
+            const auto kernel_start = std::chrono::steady_clock::now();
+            OneAssetPathBlock_BS block(vanilla.S_, vanilla.T_, vanilla.sigma_, vanilla.r_, vanilla.q_, n, path_length, Z.data());
+            std::vector<double> V(option(block));
+            stats.Add(V.data(), V.size());
+            kernel_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - kernel_start).count();
+        }
+        
+        res.push_back(PrecisionEstimate({"float64", discount * stats.Mean(), discount * stats.StdError(), 0., std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), kernel_seconds}));
+    }
+    
+    res.push_back(MixedPrecision::Price<float, PlainAccumulator<double>>(vanilla, option, path_length, num_paths, seed, block_size));
+    res.back().mode = "float32, double sums";
+    res.push_back(MixedPrecision::Price<float, KahanAccumulator<float>>(vanilla, option, path_length, num_paths, seed, block_size));
+    res.back().mode = "float32, Kahan float sums";
+    res.push_back(MixedPrecision::Price<float, PlainAccumulator<float>>(vanilla, option, path_length, num_paths, seed, block_size));
+    res.back().mode = "float32, plain float sums";
+    
+    for (PrecisionEstimate& row : res) {
+        row.difference = row.value - res.front().value;
+    }
+    return res;
+}
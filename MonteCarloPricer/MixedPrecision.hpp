@@ -0,0 +1,170 @@
+//
+//  MixedPrecision.hpp
+//  MonteCarloPricer
+//
+
+#ifndef MixedPrecision_hpp
+#define MixedPrecision_hpp
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "EuropeanOption.hpp"
+#include "PathDependentOption.hpp"
+#include "Instrumentation.hpp"
+#include "RNG.hpp"
+
+// Paths (BasicOneAssetPathBlock_BS) and the block payoffs of VanillaOption, BarrierOption and AsianOption
+// come in the floating-point type Real as well as double.
+// With Real = float a vector holds twice the lanes and a block streams half the bytes;
+// the estimator sums stay in double, or in float with Kahan compensation (see LaneAccumulator).
+
+template <class Accum, bool Compensated>
+class LaneAccumulator {
+    // Mean and sum of squared deviations (Welford) in the type Accum, spread over kLanes independent lanes:
+    // sample i goes to lane i % kLanes, so the lanes vectorize without reassociating any sum,
+    // and each one sees 1/kLanes of the terms.
+    // Compensated: every lane carries a Kahan correction on both updates, so a float lane keeps about float precision
+    // whatever the count. (The correction is algebraically zero; this relies on building without -ffast-math.)
+    // The lanes are combined in double (Chan et al.).
+private:
+    static constexpr std::size_t kLanes = 16;
+    
+    std::size_t count_ = 0;
+    Accum mean_[kLanes] = {};
+    Accum mean_c_[kLanes] = {};
+    Accum m2_[kLanes] = {};
+    Accum m2_c_[kLanes] = {};
+    
+    static void AddTo(Accum& sum, Accum& c, Accum x) {
+        if constexpr (Compensated) {
+            Accum y = x - c;
+            Accum t = sum + y;
+            c = (t - sum) - y;
+            sum = t;
+        } else {
+            sum += x;
+        }
+    }
+    
+    // Welford step of one lane, inv: 1 / (its count with x)
+    static void Update(Accum& mean, Accum& mean_c, Accum& m2, Accum& m2_c, Accum x, Accum inv) {
+        Accum delta = x - mean;
+        AddTo(mean, mean_c, delta * inv);
+        AddTo(m2, m2_c, delta * (x - mean));
+    }
+    
+    std::size_t LaneCount(std::size_t l) const { return count_ / kLanes + (l < count_ % kLanes); }
+    
+public:
+    template <class Real>
+    void Add(const Real* x, std::size_t n) {
+        MCP_TIME_STAGE(StageReduction);
+        std::size_t i = 0;
+        // Up to the next full row one lane at a time, then whole rows, where every lane has the same count
+        for (; i < n && count_ % kLanes != 0; i++, count_++) {
+            const std::size_t l = count_ % kLanes;
+            Update(mean_[l], mean_c_[l], m2_[l], m2_c_[l], static_cast<Accum>(x[i]), Accum(1) / static_cast<Accum>(count_ / kLanes + 1));
+        }
+        for (; i + kLanes <= n; i += kLanes, count_ += kLanes) {
+            const Accum inv = Accum(1) / static_cast<Accum>(count_ / kLanes + 1);
+            for (std::size_t l = 0; l < kLanes; l++) {
+                Update(mean_[l], mean_c_[l], m2_[l], m2_c_[l], static_cast<Accum>(x[i + l]), inv);
+            }
+        }
+        for (; i < n; i++, count_++) {
+            const std::size_t l = count_ % kLanes;
+            Update(mean_[l], mean_c_[l], m2_[l], m2_c_[l], static_cast<Accum>(x[i]), Accum(1) / static_cast<Accum>(count_ / kLanes + 1));
+        }
+    }
+    
+    std::size_t Count() const { return count_; }
+    double Mean() const {
+        double sum = 0.;
+        for (std::size_t l = 0; l < kLanes; l++) {
+            sum += LaneCount(l) * (static_cast<double>(mean_[l]) - static_cast<double>(mean_c_[l]));
+        }
+        return sum / count_;
+    }
+    // Sample variance (n - 1)
+    double Variance() const {
+        if (count_ < 2) return 0.;
+        const double mean = this->Mean();
+        double m2 = 0.;
+        for (std::size_t l = 0; l < kLanes; l++) {
+            const double d = static_cast<double>(mean_[l]) - static_cast<double>(mean_c_[l]) - mean;
+            m2 += static_cast<double>(m2_[l]) - static_cast<double>(m2_c_[l]) + LaneCount(l) * d * d;
+        }
+        return std::max(0., m2 / (count_ - 1.));
+    }
+    double StdError() const { return std::sqrt(this->Variance() / count_); }
+};
+
+template <class Accum>
+using PlainAccumulator = LaneAccumulator<Accum, false>;
+template <class Accum>
+using KahanAccumulator = LaneAccumulator<Accum, true>;
+
+struct PrecisionEstimate {
+    std::string mode;
+    double value;           // Discounted price
+    double std_error;
+    double difference;      // value - value of the double reference
+    double seconds;         // Whole run
+    double kernel_seconds;  // Paths, payoffs and sums: the part that runs in Real
+    
+    // Difference in units of the standard error
+    double Sigmas() const { return difference / std_error; }
+    
+    void Print() const {
+        std::cout << mode << '\t' << value << '\t' << std_error << '\t' << difference << '\t' << this->Sigmas() << '\t' << seconds << '\t' << kernel_seconds << std::endl;
+    }
+};
+
+class MixedPrecision {
+    // Prices on BasicOneAssetPathBlock_BS in the precision Real, summing discounted payoffs in an Accumulator
+    // The normals are the double stream of TradePricer (blocks of block_size paths, flat gen per block),
+    // rounded to Real, so that every precision sees the same paths and the differences are pure rounding.
+public:
+    // No instances of MixedPrecision is needed.
+    MixedPrecision() = delete;
+    ~MixedPrecision() = default;
+    
+    // payoff: VanillaOption, BarrierOption, AsianOption or alike, callable on a BasicOneAssetPathBlock<Real>
+    template <class Real, class Accumulator, class Payoff>
+    static PrecisionEstimate Price(const EuropeanOption& option, const Payoff& payoff, std::size_t path_length, std::size_t num_paths, unsigned long seed = 1, std::size_t block_size = 1 << 13) {
+        const auto start = std::chrono::steady_clock::now();
+        double kernel_seconds = 0.;
+        
+        LCE_uniform::reseed(seed);
+        Accumulator sums;
+        std::vector<Real> z;
+        for (std::size_t done = 0; done < num_paths; done += block_size) {
+            const std::size_t n = std::min(block_size, num_paths - done);
+            // Normals come in pairs
+            const std::size_t size = n * path_length;
+            const std::vector<double> Z(StandardGaussianMatrix::gen(size + size % 2));
+            z.assign(Z.cbegin(), Z.cbegin() + size);
+            
+            const auto kernel_start = std::chrono::steady_clock::now();
+            BasicOneAssetPathBlock_BS<Real> block(option.S_, option.T_, option.sigma_, option.r_, option.q_, n, path_length, z.data());
+            std::vector<Real> V(payoff(block));
+            sums.Add(V.data(), V.size());
+            kernel_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - kernel_start).count();
+        }
+        
+        const double discount = std::exp(-option.r_ * option.T_);
+        return PrecisionEstimate({"", discount * sums.Mean(), discount * sums.StdError(), 0., std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), kernel_seconds});
+    }
+    
+    // Validation report: the double path (OneAssetPathBlock_BS, BarrierOption, RunningStatistics) against
+    // float paths summed in double, in Kahan-compensated float and, for contrast, in plain float.
+    // Every row uses the same normals; difference is against the first row.
+    static std::vector<PrecisionEstimate> Validate(const BarrierOption& option, std::size_t path_length, std::size_t num_paths, unsigned long seed = 1, std::size_t block_size = 1 << 13);
+};
+
+#endif /* MixedPrecision_hpp */
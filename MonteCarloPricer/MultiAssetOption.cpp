@@ -0,0 +1,97 @@
+//
+//  MultiAssetOption.cpp
+//  MonteCarloPricer
+//
+
+#include "MultiAssetOption.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+double MultiAssetOption::Price(const MultiAssetWithPath& paths) const {
+    std::vector<double> V(this->operator()(paths));
+    
+    return std::accumulate(V.cbegin(), V.cend(), 0.) / V.size();
+}
+
+BasketOption::BasketOption(const std::vector<double>& weights, double K, const EuropeanOptionType& option_type) : weights_(weights), K_(K), option_type_(option_type) {}
+
+std::vector<double> BasketOption::operator () (const MultiAssetWithPath& paths) const {
+    const std::size_t num_paths = paths.S[0].num_paths;
+    const std::size_t last = paths.S[0].path_length - 1;
+    
+    std::vector<double> basket(num_paths, 0.);
+    for (std::size_t a = 0; a < paths.NumAssets(); a++) {
+        const double* S_T = paths.S[a].Step(last);
+        for (std::size_t p = 0; p < num_paths; p++) {
+            basket[p] += weights_[a] * S_T[p];
+        }
+    }
+    
+    const double sign = (option_type_ == Call) ? 1. : -1.;
+    for (double& v : basket) {
+        v = std::max(sign * (v - K_), 0.);
+    }
+    
+    return basket;
+}
+
+RainbowOption::RainbowOption(double K, const EuropeanOptionType& option_type, const RainbowType& rainbow_type) : K_(K), option_type_(option_type), rainbow_type_(rainbow_type) {}
+
+std::vector<double> RainbowOption::operator () (const MultiAssetWithPath& paths) const {
+    const std::size_t num_paths = paths.S[0].num_paths;
+    const std::size_t last = paths.S[0].path_length - 1;
+    
+    std::vector<double> extreme(paths.S[0].Step(last), paths.S[0].Step(last) + num_paths);
+    for (std::size_t a = 1; a < paths.NumAssets(); a++) {
+        const double* S_T = paths.S[a].Step(last);
+        if (rainbow_type_ == BestOf) {
+            for (std::size_t p = 0; p < num_paths; p++) {
+                extreme[p] = std::max(extreme[p], S_T[p]);
+            }
+        } else {
+            for (std::size_t p = 0; p < num_paths; p++) {
+                extreme[p] = std::min(extreme[p], S_T[p]);
+            }
+        }
+    }
+    
+    const double sign = (option_type_ == Call) ? 1. : -1.;
+    for (double& v : extreme) {
+        v = std::max(sign * (v - K_), 0.);
+    }
+    
+    return extreme;
+}
+
+SpreadOption::SpreadOption(std::size_t long_asset, std::size_t short_asset, double K, const EuropeanOptionType& option_type) : long_asset_(long_asset), short_asset_(short_asset), K_(K), option_type_(option_type) {}
+
+std::vector<double> SpreadOption::operator () (const MultiAssetWithPath& paths) const {
+    const std::size_t num_paths = paths.S[0].num_paths;
+    const std::size_t last = paths.S[0].path_length - 1;
+    const double* S_long = paths.S[long_asset_].Step(last);
+    const double* S_short = paths.S[short_asset_].Step(last);
+    
+    const double sign = (option_type_ == Call) ? 1. : -1.;
+    std::vector<double> V(num_paths);
+    for (std::size_t p = 0; p < num_paths; p++) {
+        V[p] = std::max(sign * (S_long[p] - S_short[p] - K_), 0.);
+    }
+    
+    return V;
+}
+
+double SpreadOption::MargrabePrice(const std::vector<double>& S0, double T, const std::vector<double>& sigma, double r, const std::vector<double>& q, double rho) const {
+    assert(K_ == 0.);
+    
+    // (S_1 - S_2)+ is a Black-Scholes call on S_1 struck at S_2, with the yield of S_2 as rate and the yield of S_1 as yield,
+    // at the volatility of S_1 / S_2; the put exchanges the roles
+    const std::size_t a_1 = (option_type_ == Call) ? long_asset_ : short_asset_;
+    const std::size_t a_2 = (option_type_ == Call) ? short_asset_ : long_asset_;
+    const double sigma_ratio = std::sqrt(sigma[a_1] * sigma[a_1] + sigma[a_2] * sigma[a_2] - 2. * rho * sigma[a_1] * sigma[a_2]);
+    EuropeanOption exchange(0., S0[a_1], S0[a_2], T, sigma_ratio, q[a_2], q[a_1]);
+    
+    // Price averages undiscounted payoffs
+    return exchange.Call() * std::exp(r * T);
+}
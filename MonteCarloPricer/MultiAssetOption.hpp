@@ -0,0 +1,73 @@
+//
+//  MultiAssetOption.hpp
+//  MonteCarloPricer
+//
+
+#ifndef MultiAssetOption_hpp
+#define MultiAssetOption_hpp
+
+#include <vector>
+#include "EuropeanOption.hpp"
+#include "MultiAssetPathGenerator.hpp"
+
+class MultiAssetOption {
+    // European-style payoff on the terminal prices of several assets
+public:
+    MultiAssetOption() = default;
+    ~MultiAssetOption() = default;
+    
+    // Payoff of every path in the block
+    virtual std::vector<double> operator () (const MultiAssetWithPath& paths) const = 0;
+    double Price(const MultiAssetWithPath& paths) const;
+};
+
+class BasketOption : public MultiAssetOption {
+    // Payoff on sum_a w_a * S_a(T)
+private:
+    std::vector<double> weights_;
+    double K_;
+    EuropeanOptionType option_type_;
+    
+public:
+    BasketOption(const std::vector<double>& weights, double K, const EuropeanOptionType& option_type);
+    
+    virtual std::vector<double> operator () (const MultiAssetWithPath& paths) const override;
+};
+
+enum RainbowType {
+    BestOf,
+    WorstOf,
+};
+
+class RainbowOption : public MultiAssetOption {
+    // Payoff on max_a S_a(T) (best-of) or min_a S_a(T) (worst-of)
+private:
+    double K_;
+    EuropeanOptionType option_type_;
+    RainbowType rainbow_type_;
+    
+public:
+    RainbowOption(double K, const EuropeanOptionType& option_type, const RainbowType& rainbow_type);
+    
+    virtual std::vector<double> operator () (const MultiAssetWithPath& paths) const override;
+};
+
+class SpreadOption : public MultiAssetOption {
+    // Payoff on S_long(T) - S_short(T)
+private:
+    std::size_t long_asset_;
+    std::size_t short_asset_;
+    double K_;
+    EuropeanOptionType option_type_;
+    
+public:
+    SpreadOption(std::size_t long_asset, std::size_t short_asset, double K, const EuropeanOptionType& option_type);
+    
+    virtual std::vector<double> operator () (const MultiAssetWithPath& paths) const override;
+    
+    // Theoretical price of the exchange option (K = 0, Margrabe), undiscounted like Price
+    // S0, sigma and q per asset; rho: correlation of the two assets
+    double MargrabePrice(const std::vector<double>& S0, double T, const std::vector<double>& sigma, double r, const std::vector<double>& q, double rho) const;
+};
+
+#endif /* MultiAssetOption_hpp */
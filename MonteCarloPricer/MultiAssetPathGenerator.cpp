@@ -0,0 +1,165 @@
+//
+//  MultiAssetPathGenerator.cpp
+//  MonteCarloPricer
+//
+
+#include "MultiAssetPathGenerator.hpp"
+#include "Instrumentation.hpp"
+#include "VectorMath.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+CorrelationFactor::CorrelationFactor(const std::vector<std::vector<double>>& correlation) : dim(correlation.size()), A(dim * dim, 0.), row_end(dim, dim), is_cholesky(true) {
+    if (this->Cholesky(correlation)) {
+        for (std::size_t i = 0; i < dim; i++) {
+            row_end[i] = i + 1;
+        }
+    } else {
+        is_cholesky = false;
+        this->PCA(correlation);
+    }
+}
+
+bool CorrelationFactor::Cholesky(const std::vector<std::vector<double>>& correlation) {
+    // Pivots below this are treated as singular
+    constexpr double tolerance = 1e-10;
+    
+    for (std::size_t i = 0; i < dim; i++) {
+        for (std::size_t j = 0; j <= i; j++) {
+            double sum = correlation[i][j];
+            for (std::size_t k = 0; k < j; k++) {
+                sum -= A[i * dim + k] * A[j * dim + k];
+            }
+            if (i == j) {
+                if (sum <= tolerance) {
+                    std::fill(A.begin(), A.end(), 0.);
+                    return false;
+                }
+                A[i * dim + i] = std::sqrt(sum);
+            } else {
+                A[i * dim + j] = sum / A[j * dim + j];
+            }
+        }
+    }
+    return true;
+}
+
+void CorrelationFactor::PCA(const std::vector<std::vector<double>>& correlation) {
+    // Cyclic Jacobi eigenvalue algorithm: C = V diag(lambda) V^T
+    std::vector<double> C(dim * dim);
+    std::vector<double> V(dim * dim, 0.);
+    for (std::size_t i = 0; i < dim; i++) {
+        std::copy(correlation[i].cbegin(), correlation[i].cend(), C.begin() + i * dim);
+        V[i * dim + i] = 1.;
+    }
+    
+    for (int sweep = 0; sweep < 100; sweep++) {
+        double off_diagonal = 0.;
+        for (std::size_t i = 0; i < dim; i++) {
+            for (std::size_t j = i + 1; j < dim; j++) {
+                off_diagonal += C[i * dim + j] * C[i * dim + j];
+            }
+        }
+        if (off_diagonal < 1e-30) break;
+        
+        for (std::size_t p = 0; p < dim; p++) {
+            for (std::size_t q = p + 1; q < dim; q++) {
+                double c_pq = C[p * dim + q];
+                if (std::abs(c_pq) < 1e-300) continue;
+                
+                double theta = (C[q * dim + q] - C[p * dim + p]) / (2. * c_pq);
+                double t = (theta >= 0. ? 1. : -1.) / (std::abs(theta) + std::sqrt(theta * theta + 1.));
+                double c = 1. / std::sqrt(t * t + 1.);
+                double s = t * c;
+                
+                for (std::size_t k = 0; k < dim; k++) {
+                    double c_kp = C[k * dim + p];
+                    double c_kq = C[k * dim + q];
+                    C[k * dim + p] = c * c_kp - s * c_kq;
+                    C[k * dim + q] = s * c_kp + c * c_kq;
+                }
+                for (std::size_t k = 0; k < dim; k++) {
+                    double c_pk = C[p * dim + k];
+                    double c_qk = C[q * dim + k];
+                    C[p * dim + k] = c * c_pk - s * c_qk;
+                    C[q * dim + k] = s * c_pk + c * c_qk;
+                }
+                for (std::size_t k = 0; k < dim; k++) {
+                    double v_kp = V[k * dim + p];
+                    double v_kq = V[k * dim + q];
+                    V[k * dim + p] = c * v_kp - s * v_kq;
+                    V[k * dim + q] = s * v_kp + c * v_kq;
+                }
+            }
+        }
+    }
+    
+    // A = V sqrt(max(lambda, 0)), rows rescaled so that diag(A A^T) = 1
+    for (std::size_t i = 0; i < dim; i++) {
+        double row_norm = 0.;
+        for (std::size_t j = 0; j < dim; j++) {
+            double lambda = std::max(C[j * dim + j], 0.);
+            A[i * dim + j] = V[i * dim + j] * std::sqrt(lambda);
+            row_norm += A[i * dim + j] * A[i * dim + j];
+        }
+        row_norm = std::sqrt(row_norm);
+        for (std::size_t j = 0; j < dim; j++) {
+            A[i * dim + j] /= row_norm;
+        }
+    }
+}
+
+MultiAssetWithPath_BS::MultiAssetWithPath_BS(const std::vector<double>& S0, double T, const std::vector<double>& sigma, double r, const std::vector<double>& q, const CorrelationFactor& factor, std::size_t num_paths, std::size_t path_length, const std::vector<double>& z) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const std::size_t num_assets = S0.size();
+    assert(factor.dim == num_assets && z.size() == num_assets * path_length * num_paths);
+    
+    const double dt = T / path_length;
+    std::vector<double> drift(num_assets), vol(num_assets);
+    for (std::size_t a = 0; a < num_assets; a++) {
+        drift[a] = (r - q[a] - sigma[a] * sigma[a] / 2.) * dt;
+        vol[a] = sigma[a] * std::sqrt(dt);
+        S.emplace_back(S0[a], num_paths, path_length);
+    }
+    
+    // Log prices of every asset and path at the current step
+    std::vector<double> log_S(num_assets * num_paths);
+    for (std::size_t a = 0; a < num_assets; a++) {
+        std::fill(log_S.begin() + a * num_paths, log_S.begin() + (a + 1) * num_paths, std::log(S0[a]));
+    }
+    
+    // Paths are processed in chunks so that the rows of the matrix multiply stay in cache
+    constexpr std::size_t chunk = 256;
+    std::vector<double> w(chunk);
+    
+    for (std::size_t t = 0; t < path_length; t++) {
+        for (std::size_t p0 = 0; p0 < num_paths; p0 += chunk) {
+            const std::size_t len = std::min(chunk, num_paths - p0);
+            
+            for (std::size_t a = 0; a < num_assets; a++) {
+                // w = sum_b A[a][b] * z_b, over this chunk of paths
+                std::fill(w.begin(), w.begin() + len, 0.);
+                for (std::size_t b = 0; b < factor.row_end[a]; b++) {
+                    const double A_ab = factor.A[a * num_assets + b];
+                    const double* z_row = z.data() + (b * path_length + t) * num_paths + p0;
+                    for (std::size_t p = 0; p < len; p++) {
+                        w[p] += A_ab * z_row[p];
+                    }
+                }
+                
+                double* log_S_row = log_S.data() + a * num_paths + p0;
+                double* S_row = S[a].Step(t) + p0;
+                for (std::size_t p = 0; p < len; p++) {
+                    log_S_row[p] += drift[a] + vol[a] * w[p];
+                    S_row[p] = log_S_row[p];
+                }
+            }
+        }
+    }
+    
+    for (OneAssetPathBlock& block : S) {
+        VectorMath::Exp(block.S);
+    }
+}
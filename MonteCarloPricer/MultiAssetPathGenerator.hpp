@@ -0,0 +1,52 @@
+//
+//  MultiAssetPathGenerator.hpp
+//  MonteCarloPricer
+//
+
+#ifndef MultiAssetPathGenerator_hpp
+#define MultiAssetPathGenerator_hpp
+
+#include <vector>
+#include "PathGenerator.hpp"
+
+class CorrelationFactor {
+    // Factor A of a correlation matrix C, with A * A^T = C
+    // Cholesky if C is (numerically) positive definite
+    // Otherwise PCA: eigenvalues are clipped at zero and rows rescaled to unit variance
+public:
+    std::size_t dim;
+    std::vector<double> A;              // Row-major, dim x dim
+    std::vector<std::size_t> row_end;   // A[i][j] == 0 for j >= row_end[i]
+    bool is_cholesky;
+    
+    CorrelationFactor(const std::vector<std::vector<double>>& correlation);
+    ~CorrelationFactor() = default;
+    
+private:
+    bool Cholesky(const std::vector<std::vector<double>>& correlation);
+    void PCA(const std::vector<std::vector<double>>& correlation);
+};
+
+class MultiAssetWithPath {
+    // Several assets
+    // One time-major path block per asset, S[a].Step(t)[p]
+public:
+    std::vector<OneAssetPathBlock> S;
+    
+    MultiAssetWithPath() = default;
+    ~MultiAssetWithPath() = default;
+    
+    std::size_t NumAssets() const { return S.size(); }
+};
+
+class MultiAssetWithPath_BS : public MultiAssetWithPath {
+    // Several assets
+    // The whole paths are generated
+    // Correlated log-normal model (Black-Scholes model)
+public:
+    // z: independent standard normals, z[(a * path_length + t) * num_paths + p]
+    MultiAssetWithPath_BS(const std::vector<double>& S0, double T, const std::vector<double>& sigma, double r, const std::vector<double>& q, const CorrelationFactor& factor, std::size_t num_paths, std::size_t path_length, const std::vector<double>& z);
+    ~MultiAssetWithPath_BS() = default;
+};
+
+#endif /* MultiAssetPathGenerator_hpp */
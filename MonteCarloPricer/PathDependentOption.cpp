@@ -6,10 +6,16 @@
 //
 
 #include "PathDependentOption.hpp"
+#include "Instrumentation.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <numeric>
 #include <iostream>
+#include <numbers>
 
 double PathDependentOption::Price(const std::vector<std::vector<double>>& S) const {
+    MCP_TIME_STAGE(StagePayoff);
     std::vector<double> V;
     V.reserve(S.size());
     
@@ -20,12 +26,75 @@ double PathDependentOption::Price(const std::vector<std::vector<double>>& S) con
     return std::accumulate(V.cbegin(), V.cend(), 0.) / V.size();
 }
 
+std::vector<double> PathDependentOption::operator () (const OneAssetPathBlock& block) const {
+    MCP_TIME_STAGE(StagePayoff);
+    std::vector<double> V(block.num_paths);
+    std::vector<double> path(block.path_length);
+    
+    for (std::size_t p = 0; p < block.num_paths; p++) {
+        for (std::size_t t = 0; t < block.path_length; t++) {
+            path[t] = block.Step(t)[p];
+        }
+        V[p] = this->operator()(path);
+    }
+    
+    return V;
+}
+
+double PathDependentOption::Price(const OneAssetPathBlock& block) const {
+    std::vector<double> V(this->operator()(block));
+    
+    return std::accumulate(V.cbegin(), V.cend(), 0.) / V.size();
+}
+
+VanillaOption::VanillaOption(const EuropeanOption& option, const EuropeanOptionType& option_type) : option_(option), option_type_(option_type) {}
+
+double VanillaOption::operator () (const std::vector<double>& path) const {
+    const double sign = (option_type_ == Call) ? 1. : -1.;
+    return std::max(sign * (path.back() - option_.K_), 0.);
+}
+
+template <class Real>
+std::vector<Real> VanillaOption::Evaluate(const BasicOneAssetPathBlock<Real>& block) const {
+    MCP_TIME_STAGE(StagePayoff);
+    const Real sign = (option_type_ == Call) ? Real(1) : Real(-1);
+    const Real K = static_cast<Real>(option_.K_);
+    const Real* S_T = block.Step(block.path_length - 1);
+    
+    std::vector<Real> V(block.num_paths);
+    for (std::size_t p = 0; p < block.num_paths; p++) {
+        V[p] = std::max(sign * (S_T[p] - K), Real(0));
+    }
+    
+    return V;
+}
+
+std::vector<double> VanillaOption::operator () (const OneAssetPathBlock& block) const {
+    return this->Evaluate(block);
+}
+
+std::vector<float> VanillaOption::operator () (const BasicOneAssetPathBlock<float>& block) const {
+    return this->Evaluate(block);
+}
+
 BarrierOption::BarrierOption(const EuropeanOption& option, double B, const EuropeanOptionType& option_type, const BarrierType& barrier_type) : option_(option), B_(B), option_type_(option_type), barrier_type_(barrier_type) {}
 
 EuropeanOption BarrierOption::GetVanillaOption() const {
     return option_;
 }
 
+EuropeanOptionType BarrierOption::GetOptionType() const {
+    return option_type_;
+}
+
+double BarrierOption::GetBarrier() const {
+    return B_;
+}
+
+BarrierType BarrierOption::GetBarrierType() const {
+    return barrier_type_;
+}
+
 double BarrierOption::operator () (const std::vector<double>& path) const {
     switch (barrier_type_) {
         case UpAndIn:
@@ -40,6 +109,7 @@ double BarrierOption::operator () (const std::vector<double>& path) const {
                         }
                     }
                 }
+                MCP_COUNT(CountPathsKnockedOut, 1);
                 return 0.;
             } break;
             
@@ -47,6 +117,7 @@ double BarrierOption::operator () (const std::vector<double>& path) const {
             {
                 for (double node : path) {
                     if (node >= B_) {
+                        MCP_COUNT(CountPathsKnockedOut, 1);
                         return 0.;
                     }
                 }
@@ -70,6 +141,7 @@ double BarrierOption::operator () (const std::vector<double>& path) const {
                         }
                     }
                 }
+                MCP_COUNT(CountPathsKnockedOut, 1);
                 return 0.;
             } break;
             
@@ -77,6 +149,7 @@ double BarrierOption::operator () (const std::vector<double>& path) const {
             {
                 for (double node : path) {
                     if (node <= B_) {
+                        MCP_COUNT(CountPathsKnockedOut, 1);
                         return 0.;
                     }
                 }
@@ -88,6 +161,54 @@ double BarrierOption::operator () (const std::vector<double>& path) const {
                 }
             } break;
     }
+    
+    return 0.;
+}
+
+template <class Real>
+std::vector<Real> BarrierOption::Evaluate(const BasicOneAssetPathBlock<Real>& block) const {
+    MCP_TIME_STAGE(StagePayoff);
+    const std::size_t num_paths = block.num_paths;
+    const bool is_up = (barrier_type_ == UpAndIn) || (barrier_type_ == UpAndOut);
+    const bool is_in = (barrier_type_ == UpAndIn) || (barrier_type_ == DownAndIn);
+    
+    // Running max (up barriers) or min (down barriers) of every path
+    std::vector<Real> extreme(block.Step(0), block.Step(0) + num_paths);
+    for (std::size_t t = 1; t < block.path_length; t++) {
+        const Real* row = block.Step(t);
+        if (is_up) {
+            for (std::size_t p = 0; p < num_paths; p++) {
+                extreme[p] = std::max(extreme[p], row[p]);
+            }
+        } else {
+            for (std::size_t p = 0; p < num_paths; p++) {
+                extreme[p] = std::min(extreme[p], row[p]);
+            }
+        }
+    }
+    
+    // Lane mask: a path pays iff (barrier touched) == (knock-in)
+    const Real* S_T = block.Step(block.path_length - 1);
+    const Real sign = (option_type_ == Call) ? Real(1) : Real(-1);
+    const Real K = static_cast<Real>(option_.K_);
+    const Real B = static_cast<Real>(B_);
+    std::vector<Real> V(num_paths);
+    for (std::size_t p = 0; p < num_paths; p++) {
+        bool touched = is_up ? (extreme[p] >= B) : (extreme[p] <= B);
+        Real vanilla = std::max(sign * (S_T[p] - K), Real(0));
+        V[p] = (touched == is_in) ? vanilla : Real(0);
+        MCP_COUNT(CountPathsKnockedOut, touched != is_in);
+    }
+    
+    return V;
+}
+
+std::vector<double> BarrierOption::operator () (const OneAssetPathBlock& block) const {
+    return this->Evaluate(block);
+}
+
+std::vector<float> BarrierOption::operator () (const BasicOneAssetPathBlock<float>& block) const {
+    return this->Evaluate(block);
 }
 
 double BarrierOption::BSPrice() const {
@@ -114,6 +235,8 @@ double BarrierOption::BSPrice() const {
         case Put:
             return 0.;
     }
+    
+    return 0.;
 }
 
 AsianOption::AsianOption(const EuropeanOption& option, const EuropeanOptionType& option_type) : option_(option), option_type_(option_type) {}
@@ -124,3 +247,188 @@ double AsianOption::operator () (const std::vector<double>& path) const {
     double avg_S = sum_S / (path.size() + 1.);
     return std::max(0., avg_S - option_.K_);
 }
+
+template <class Real>
+std::vector<Real> AsianOption::Evaluate(const BasicOneAssetPathBlock<Real>& block) const {
+    MCP_TIME_STAGE(StagePayoff);
+    // !!!: ASIAN CALL
+    const std::size_t num_paths = block.num_paths;
+    
+    // Running sum across paths, one time step at a time
+    std::vector<Real> sum_S(num_paths, Real(0));
+    for (std::size_t t = 0; t < block.path_length; t++) {
+        const Real* row = block.Step(t);
+        for (std::size_t p = 0; p < num_paths; p++) {
+            sum_S[p] += row[p];
+        }
+    }
+    
+    const Real S0 = static_cast<Real>(block.S0);
+    const Real nodes = static_cast<Real>(block.path_length + 1.);
+    const Real K = static_cast<Real>(option_.K_);
+    std::vector<Real> V(num_paths);
+    for (std::size_t p = 0; p < num_paths; p++) {
+        Real avg_S = (sum_S[p] + S0) / nodes;
+        V[p] = std::max(Real(0), avg_S - K);
+    }
+    
+    return V;
+}
+
+std::vector<double> AsianOption::operator () (const OneAssetPathBlock& block) const {
+    return this->Evaluate(block);
+}
+
+std::vector<float> AsianOption::operator () (const BasicOneAssetPathBlock<float>& block) const {
+    return this->Evaluate(block);
+}
+
+LookbackOption::LookbackOption(const EuropeanOption& option, const EuropeanOptionType& option_type, const LookbackType& lookback_type) : option_(option), option_type_(option_type), lookback_type_(lookback_type) {}
+
+EuropeanOption LookbackOption::GetVanillaOption() const {
+    return option_;
+}
+
+EuropeanOptionType LookbackOption::GetOptionType() const {
+    return option_type_;
+}
+
+bool LookbackOption::UsesMaximum() const {
+    return (lookback_type_ == FloatingStrike) == (option_type_ == Put);
+}
+
+std::vector<double> LookbackOption::Payoff(const std::vector<double>& extreme, const double* S_T) const {
+    const std::size_t num_paths = extreme.size();
+    std::vector<double> V(num_paths);
+    
+    switch (lookback_type_) {
+        case FloatingStrike:
+            for (std::size_t p = 0; p < num_paths; p++) {
+                V[p] = (option_type_ == Call) ? S_T[p] - extreme[p] : extreme[p] - S_T[p];
+            }
+            break;
+            
+        case FixedStrike:
+            for (std::size_t p = 0; p < num_paths; p++) {
+                V[p] = (option_type_ == Call) ? std::max(extreme[p] - option_.K_, 0.) : std::max(option_.K_ - extreme[p], 0.);
+            }
+            break;
+    }
+    
+    return V;
+}
+
+double LookbackOption::operator () (const std::vector<double>& path) const {
+    double extreme = UsesMaximum() ? std::max(*std::max_element(path.cbegin(), path.cend()), option_.S_) : std::min(*std::min_element(path.cbegin(), path.cend()), option_.S_);
+    return this->Payoff({extreme}, &path.back())[0];
+}
+
+std::vector<double> LookbackOption::operator () (const OneAssetPathBlock& block) const {
+    MCP_TIME_STAGE(StagePayoff);
+    const std::size_t num_paths = block.num_paths;
+    const bool is_max = UsesMaximum();
+    
+    // Running extremes across paths, one time step at a time
+    std::vector<double> extreme(num_paths, block.S0);
+    for (std::size_t t = 0; t < block.path_length; t++) {
+        const double* row = block.Step(t);
+        for (std::size_t p = 0; p < num_paths; p++) {
+            extreme[p] = is_max ? std::max(extreme[p], row[p]) : std::min(extreme[p], row[p]);
+        }
+    }
+    
+    return this->Payoff(extreme, block.Step(block.path_length - 1));
+}
+
+std::vector<double> LookbackOption::operator () (const OneAssetExtremeBlock_BS& block) const {
+    MCP_TIME_STAGE(StagePayoff);
+    assert(block.is_max == UsesMaximum());
+    const std::size_t num_paths = block.num_paths;
+    const bool is_max = block.is_max;
+    
+    // Running extremes of the interval extremes
+    std::vector<double> extreme(num_paths, block.S0);
+    for (std::size_t t = 0; t < block.path_length; t++) {
+        const double* row = block.Extreme(t);
+        for (std::size_t p = 0; p < num_paths; p++) {
+            extreme[p] = is_max ? std::max(extreme[p], row[p]) : std::min(extreme[p], row[p]);
+        }
+    }
+    
+    return this->Payoff(extreme, block.Step(block.path_length - 1));
+}
+
+namespace {
+
+// CDF of a standard normal variable
+double NormalCDF(double x) {
+    return .5 * std::erfc(-x / std::sqrt(2.));
+}
+
+// Density of a standard normal variable
+double NormalPDF(double x) {
+    return std::exp(-x * x / 2.) / std::sqrt(2. * std::numbers::pi);
+}
+
+}
+
+double LookbackOption::BSPrice() const {
+    const double S = option_.S_;
+    const double tau = option_.T_ - option_.t_;
+    const double sigma = option_.sigma_;
+    const double b = option_.r_ - option_.q_;   // Cost of carry
+    
+    const double sigma_sqrt_tau = sigma * std::sqrt(tau);
+    const double r_disc = std::exp(-option_.r_ * tau);
+    const double q_disc = std::exp(-option_.q_ * tau);
+    const double lambda = sigma * sigma / (2. * b);
+    const double reflection = 2. * b * std::sqrt(tau) / sigma;
+    
+    // The reflection terms are lambda times a difference of order b tau, which cancels as b -> 0.
+    // Below sqrt(epsilon) the limit, sigma sqrt(tau) (phi(x) + x N(x)) at the matching argument x, is closer.
+    const bool zero_carry = std::abs(b) * tau < 1e-8;
+    auto zero_carry_term = [&](double x)->double {
+        return sigma_sqrt_tau * (NormalPDF(x) + x * NormalCDF(x));
+    };
+    
+    // Monitoring starts now, so the running extreme is the spot
+    // Every case is a reference level X (spot or strike) plus a reflection term
+    auto d1 = [&](double X)->double {
+        return (std::log(S / X) + (b + sigma * sigma / 2.) * tau) / sigma_sqrt_tau;
+    };
+    
+    switch (lookback_type_) {
+        case FloatingStrike: {
+            const double a1 = d1(S);
+            const double a2 = a1 - sigma_sqrt_tau;
+            if (option_type_ == Call) {
+                const double term = zero_carry ? zero_carry_term(-a1) : lambda * (NormalCDF(-a1 + reflection) - std::exp(b * tau) * NormalCDF(-a1));
+                return S * q_disc * NormalCDF(a1) - S * r_disc * NormalCDF(a2) + S * r_disc * term;
+            } else {
+                const double term = zero_carry ? zero_carry_term(a1) : lambda * (-NormalCDF(a1 - reflection) + std::exp(b * tau) * NormalCDF(a1));
+                return S * r_disc * NormalCDF(-a2) - S * q_disc * NormalCDF(-a1) + S * r_disc * term;
+            }
+        }
+            
+        case FixedStrike: {
+            const double K = option_.K_;
+            if (option_type_ == Call) {
+                // Running maximum starts at S
+                const double X = std::max(K, S);
+                const double e1 = d1(X);
+                const double e2 = e1 - sigma_sqrt_tau;
+                const double term = zero_carry ? zero_carry_term(e1) : lambda * (-std::pow(S / X, -1. / lambda) * NormalCDF(e1 - reflection) + std::exp(b * tau) * NormalCDF(e1));
+                return r_disc * (X - K) + S * q_disc * NormalCDF(e1) - X * r_disc * NormalCDF(e2) + S * r_disc * term;
+            } else {
+                // Running minimum starts at S
+                const double X = std::min(K, S);
+                const double f1 = d1(X);
+                const double f2 = f1 - sigma_sqrt_tau;
+                const double term = zero_carry ? zero_carry_term(-f1) : lambda * (std::pow(S / X, -1. / lambda) * NormalCDF(-f1 + reflection) - std::exp(b * tau) * NormalCDF(-f1));
+                return r_disc * (K - X) - S * q_disc * NormalCDF(-f1) + X * r_disc * NormalCDF(-f2) + S * r_disc * term;
+            }
+        }
+    }
+    
+    return 0.;
+}
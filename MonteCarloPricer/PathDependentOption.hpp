@@ -11,6 +11,7 @@
 #include <functional>
 #include <vector>
 #include "EuropeanOption.hpp"
+#include "PathGenerator.hpp"
 
 class PathDependentOption {
 public:
@@ -19,6 +20,34 @@ public:
     
     virtual double operator () (const std::vector<double>& path) const = 0;
     double Price(const std::vector<std::vector<double>>& S) const;
+    
+    // Payoffs of a whole block of paths, evaluated one time step at a time across paths
+    // Falls back to one call per path unless overridden
+    virtual std::vector<double> operator () (const OneAssetPathBlock& block) const;
+    double Price(const OneAssetPathBlock& block) const;
+    
+    // Whether the payoff only reads the last node, so that generators may skip the others
+    virtual bool TerminalOnly() const { return false; }
+};
+
+class VanillaOption : public PathDependentOption {
+    // European payoff on the last node of the path
+private:
+    EuropeanOption option_; // Corresponding European option
+    EuropeanOptionType option_type_;
+    
+    template <class Real>
+    std::vector<Real> Evaluate(const BasicOneAssetPathBlock<Real>& block) const;
+    
+public:
+    VanillaOption(const EuropeanOption& option, const EuropeanOptionType& option_type);
+    
+    virtual double operator () (const std::vector<double>& path) const override;
+    virtual std::vector<double> operator () (const OneAssetPathBlock& block) const override;
+    // The same payoff in float (MixedPrecision)
+    std::vector<float> operator () (const BasicOneAssetPathBlock<float>& block) const;
+    
+    virtual bool TerminalOnly() const override { return true; }
 };
 
 enum BarrierType {
@@ -36,12 +65,22 @@ private:
     EuropeanOptionType option_type_;
     BarrierType barrier_type_;
     
+    template <class Real>
+    std::vector<Real> Evaluate(const BasicOneAssetPathBlock<Real>& block) const;
+    
 public:
     BarrierOption(const EuropeanOption& option, double B, const EuropeanOptionType& option_type, const BarrierType& barrier_type);
     
     EuropeanOption GetVanillaOption() const;
+    EuropeanOptionType GetOptionType() const;
+    double GetBarrier() const;
+    BarrierType GetBarrierType() const;
     
     virtual double operator () (const std::vector<double>& path) const override;
+    virtual std::vector<double> operator () (const OneAssetPathBlock& block) const override;
+    // The same payoff in float (MixedPrecision)
+    // B and K are rounded to float: only paths whose extreme lies within one rounding of B can flip
+    std::vector<float> operator () (const BasicOneAssetPathBlock<float>& block) const;
     
     // Theoretical price
     double BSPrice() const;
@@ -52,10 +91,50 @@ private:
     EuropeanOption option_; // Corresponding European option
     EuropeanOptionType option_type_;
     
+    template <class Real>
+    std::vector<Real> Evaluate(const BasicOneAssetPathBlock<Real>& block) const;
+    
 public:
     AsianOption(const EuropeanOption& option, const EuropeanOptionType& option_type);
     
     virtual double operator () (const std::vector<double>& path) const override;
+    virtual std::vector<double> operator () (const OneAssetPathBlock& block) const override;
+    // The same payoff in float (MixedPrecision); the running sum over the steps stays in float
+    std::vector<float> operator () (const BasicOneAssetPathBlock<float>& block) const;
+};
+
+enum LookbackType {
+    FloatingStrike, // Call: S_T - min S, put: max S - S_T
+    FixedStrike,    // Call: (max S - K)+, put: (K - min S)+
+};
+
+class LookbackOption : public PathDependentOption {
+    // Running extremes include the spot at inception
+private:
+    EuropeanOption option_; // Corresponding European option
+    EuropeanOptionType option_type_;
+    LookbackType lookback_type_;
+    
+    // Payoffs given the running extreme and the terminal price of each path
+    std::vector<double> Payoff(const std::vector<double>& extreme, const double* S_T) const;
+    
+public:
+    LookbackOption(const EuropeanOption& option, const EuropeanOptionType& option_type, const LookbackType& lookback_type);
+    
+    EuropeanOption GetVanillaOption() const;
+    EuropeanOptionType GetOptionType() const;
+    // Whether the payoff reads the running maximum (otherwise the running minimum)
+    bool UsesMaximum() const;
+    
+    // Discrete monitoring at the nodes
+    virtual double operator () (const std::vector<double>& path) const override;
+    virtual std::vector<double> operator () (const OneAssetPathBlock& block) const override;
+    // Continuous monitoring, from the interval extremes sampled along the bridge
+    std::vector<double> operator () (const OneAssetExtremeBlock_BS& block) const;
+    
+    // Theoretical price under continuous monitoring
+    // Goldman-Sosin-Gatto (floating strike), Conze-Viswanathan (fixed strike); their b -> 0 limit when r == q
+    double BSPrice() const;
 };
 
 #endif /* PathDependentOption_hpp */
@@ -6,12 +6,21 @@
 //
 
 #include "PathGenerator.hpp"
+#include "Instrumentation.hpp"
+#include "VectorMath.hpp"
+#include "RNG.hpp"
 #include <algorithm>
 #include <cmath>
+#include <cassert>
+#include <numeric>
+#include <type_traits>
 
-OneAssetNoPath::OneAssetNoPath(std::size_t size) : S(size) {}
+OneAssetNoPath::OneAssetNoPath(std::size_t size) : S(size) {
+    MCP_COUNT(CountBytesAllocated, size * sizeof(double));
+}
 
 OneAssetNoPath_BS::OneAssetNoPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<double>& z_arr) : OneAssetNoPath(z_arr.size()) {
+    MCP_TIME_STAGE(StagePathBuild);
     
     auto z_to_s = [&](double z)->double {
         return S0 * std::exp((r - q - sigma * sigma / 2.) * T + sigma * std::sqrt(T) * z);
@@ -20,41 +29,56 @@ OneAssetNoPath_BS::OneAssetNoPath_BS(double S0, double T, double sigma, double r
     std::transform(z_arr.cbegin(), z_arr.cend(), S.begin(), z_to_s);
 }
 
-OneAssetWithPath::OneAssetWithPath(const std::vector<std::vector<double>>& z_arr) : S(z_arr) {}
+OneAssetNoPath_BS::OneAssetNoPath_BS(double S0, const TimeGridIntegrals& grid, const std::vector<double>& z_arr) : OneAssetNoPath(z_arr.size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    assert(grid.Steps() == 1);
+    const double log_S0 = std::log(S0) + grid.drift[0];
+    const double vol = grid.vol[0];
+    
+    std::transform(z_arr.cbegin(), z_arr.cend(), S.begin(), [=](double z)->double { return log_S0 + vol * z; });
+    VectorMath::Exp(S);
+}
+
+OneAssetWithPath::OneAssetWithPath(const std::vector<std::vector<double>>& z_arr) : S(z_arr) {
+    MCP_COUNT(CountBytesAllocated, z_arr.size() * (z_arr.empty() ? 0 : z_arr[0].size()) * sizeof(double));
+}
 
 OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr) : OneAssetWithPath(z_arr) {
+    MCP_TIME_STAGE(StagePathBuild);
     
-    double dt = T / z_arr[0].size();
+    const double dt = T / z_arr[0].size();
+    const double drift = (r - q - sigma * sigma / 2.) * dt;
+    const double vol = sigma * std::sqrt(dt);
+    const double log_S0 = std::log(S0);
     
     for (std::vector<double>& path : S) {
-        double curr_S = S0;
+        // Prefix sum of log increments
+        double log_S = log_S0;
         for (double& node: path) {
-            curr_S *= std::exp((r - q - sigma * sigma / 2.) * dt + sigma * std::sqrt(dt) * node);
-            node = curr_S;
+            log_S += drift + vol * node;
+            node = log_S;
         }
+        VectorMath::Exp(path);
     }
 }
 
-OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, const Dividend& proportional, const Dividend& fixed) : OneAssetWithPath(z_arr) {
+DividendSchedule::DividendSchedule(double T, double sigma, double r, double q, const Dividend& proportional, const Dividend& fixed) : T_(T), sigma_(sigma), r_(r), q_(q), proportional_factor_(1.) {
     
     auto tit_prop = proportional.dates.cbegin();
     auto dit_prop = proportional.dividends.cbegin();
     auto tit_fixed = fixed.dates.cbegin();
     auto dit_fixed = fixed.dividends.cbegin();
     
-    std::vector<double> dividend_value;
-    std::vector<bool> dividend_is_fixed;
-    std::vector<double> time_diff;
-    
     double curr_time = 0.;
     while ((tit_prop != proportional.dates.cend()) || (tit_fixed != fixed.dates.cend())) {
         if (tit_prop == proportional.dates.cend()) {
             // Proportional dividends exhausted, apply all remaining fixed dividends
             while (tit_fixed != fixed.dates.cend()) {
-                dividend_value.push_back(*dit_fixed);
-                dividend_is_fixed.push_back(true);
+                dividend_value_.push_back(*dit_fixed);
+                dividend_is_fixed_.push_back(true);
                 
-                time_diff.push_back(*tit_fixed - curr_time);
+                time_diff_.push_back(*tit_fixed - curr_time);
                 curr_time = *tit_fixed;
                 
                 dit_fixed++;
@@ -64,10 +88,10 @@ OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, double T, double sigma, doub
         } else if (tit_fixed == fixed.dates.cend()) {
             // Fixed dividends exhausted, apply all remaining proportional dividends
             while (tit_prop != proportional.dates.cend()) {
-                dividend_value.push_back(*dit_prop);
-                dividend_is_fixed.push_back(false);
+                dividend_value_.push_back(*dit_prop);
+                dividend_is_fixed_.push_back(false);
                 
-                time_diff.push_back(*tit_prop - curr_time);
+                time_diff_.push_back(*tit_prop - curr_time);
                 curr_time = *tit_prop;
                 
                 dit_prop++;
@@ -79,20 +103,20 @@ OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, double T, double sigma, doub
             // Proportional dividends go first if (in the unlikely case that) two dividends coincide in time
             if ((*tit_fixed) < (*tit_prop)) {
                 // The fixed dividend is earlier
-                dividend_value.push_back(*dit_fixed);
-                dividend_is_fixed.push_back(true);
+                dividend_value_.push_back(*dit_fixed);
+                dividend_is_fixed_.push_back(true);
                 
-                time_diff.push_back(*tit_fixed - curr_time);
+                time_diff_.push_back(*tit_fixed - curr_time);
                 curr_time = *tit_fixed;
                 
                 dit_fixed++;
                 tit_fixed++;
             } else {
                 // The proportional dividend is earlier
-                dividend_value.push_back(*dit_prop);
-                dividend_is_fixed.push_back(false);
+                dividend_value_.push_back(*dit_prop);
+                dividend_is_fixed_.push_back(false);
                 
-                time_diff.push_back(*tit_prop - curr_time);
+                time_diff_.push_back(*tit_prop - curr_time);
                 curr_time = *tit_prop;
                 
                 dit_prop++;
@@ -101,20 +125,233 @@ OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, double T, double sigma, doub
         }
     }
     
-    time_diff.push_back(T - curr_time);
+    time_diff_.push_back(T - curr_time);
+    
+    // Per-interval increments, so that each node costs one multiply-add and one exp
+    for (std::size_t i = 0; i < time_diff_.size(); i++) {
+        sqrt_time_diff_.push_back(std::sqrt(time_diff_[i]));
+        drift_.push_back((r - q - sigma * sigma / 2.) * time_diff_[i]);
+        vol_.push_back(sigma * sqrt_time_diff_[i]);
+        
+        if (i + 1 == time_diff_.size()) {
+            // No dividend at maturity
+            multiplier_.push_back(1.);
+            subtrahend_.push_back(0.);
+        } else if (dividend_is_fixed_[i]) {
+            multiplier_.push_back(1.);
+            subtrahend_.push_back(dividend_value_[i]);
+        } else {
+            multiplier_.push_back(1. - dividend_value_[i]);
+            subtrahend_.push_back(0.);
+            proportional_factor_ *= (1. - dividend_value_[i]);
+        }
+    }
+}
+
+OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, const TimeGridIntegrals& grid, const std::vector<std::vector<double>>& z_arr) : OneAssetWithPath(z_arr) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const double* drift = grid.drift.data();
+    const double* vol = grid.vol.data();
+    const double log_S0 = std::log(S0);
+    
+    for (std::vector<double>& path : S) {
+        assert(path.size() == grid.Steps());
+        // Prefix sum of log increments
+        double log_S = log_S0;
+        for (std::size_t i = 0; i < path.size(); i++) {
+            log_S += drift[i] + vol[i] * path[i];
+            path[i] = log_S;
+        }
+        VectorMath::Exp(path);
+    }
+}
+
+OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, const Dividend& proportional, const Dividend& fixed) : OneAssetWithPath_BS(S0, z_arr, DividendSchedule(T, sigma, r, q, proportional, fixed)) {}
+
+OneAssetWithPath_BS::OneAssetWithPath_BS(double S0, const std::vector<std::vector<double>>& z_arr, const DividendSchedule& schedule) : OneAssetWithPath(z_arr) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const double* drift = schedule.Drift().data();
+    const double* vol = schedule.Vol().data();
+    const double* multiplier = schedule.Multiplier().data();
+    const double* subtrahend = schedule.Subtrahend().data();
     
     for (std::vector<double>& path : S) {
+        assert(path.size() == schedule.Intervals());
         double curr_S = S0;
         for (std::size_t i = 0; i < path.size(); i++) {
-            curr_S *= std::exp((r - sigma * sigma / 2.) * time_diff[i] + sigma * std::sqrt(time_diff[i]) * path[i]);
-            if (i + 1 == path.size()) {
-                
-            } else if (dividend_is_fixed[i]) {
-                curr_S -= dividend_value[i];
-            } else {
-                curr_S *= (1. - dividend_value[i]);
-            }
+            curr_S *= std::exp(drift[i] + vol[i] * path[i]);
+            curr_S = curr_S * multiplier[i] - subtrahend[i];
             path[i] = curr_S;
         }
     }
 }
+
+template <class Real>
+BasicOneAssetPathBlock<Real>::BasicOneAssetPathBlock(double S0, std::size_t num_paths, std::size_t path_length) : S0(S0), num_paths(num_paths), path_length(path_length), S(num_paths * path_length) {
+    MCP_COUNT(CountBytesAllocated, S.size() * sizeof(Real));
+}
+
+template <class Real>
+BasicOneAssetPathBlock<Real>::BasicOneAssetPathBlock(double S0, const std::vector<std::vector<double>>& paths) : BasicOneAssetPathBlock(S0, paths.size(), paths.empty() ? 0 : paths[0].size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    for (std::size_t p = 0; p < num_paths; p++) {
+        for (std::size_t t = 0; t < path_length; t++) {
+            S[t * num_paths + p] = static_cast<Real>(paths[p][t]);
+        }
+    }
+}
+
+template <class Real>
+Real* BasicOneAssetPathBlock<Real>::Step(std::size_t t) {
+    return S.data() + t * num_paths;
+}
+
+template <class Real>
+const Real* BasicOneAssetPathBlock<Real>::Step(std::size_t t) const {
+    return S.data() + t * num_paths;
+}
+
+template class BasicOneAssetPathBlock<double>;
+template class BasicOneAssetPathBlock<float>;
+
+namespace {
+
+std::vector<std::size_t> ObservedNodes(const std::vector<std::size_t>& observed, std::size_t path_length) {
+    if (!observed.empty()) {
+        assert(std::is_sorted(observed.cbegin(), observed.cend()) && observed.back() < path_length);
+        return observed;
+    }
+    std::vector<std::size_t> all(path_length);
+    std::iota(all.begin(), all.end(), 0);
+    return all;
+}
+
+}
+
+template <class Real>
+BasicOneAssetPathBlock_BS<Real>::BasicOneAssetPathBlock_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, const std::vector<std::size_t>& observed) : BasicOneAssetPathBlock<Real>(S0, z_arr.size(), ObservedNodes(observed, z_arr[0].size()).size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const std::size_t num_paths = this->num_paths;
+    const std::vector<std::size_t> nodes(ObservedNodes(observed, z_arr[0].size()));
+    const double dt = T / z_arr[0].size();
+    const double drift = (r - q - sigma * sigma / 2.) * dt;
+    const double vol = sigma * std::sqrt(dt);
+    const double log_S0 = std::log(S0);
+    
+    for (std::size_t p = 0; p < num_paths; p++) {
+        const std::vector<double>& z_path = z_arr[p];
+        double log_S = log_S0;
+        std::size_t t = 0;
+        for (std::size_t k = 0; k < nodes.size(); k++) {
+            for (; t <= nodes[k]; t++) {
+                log_S += drift + vol * z_path[t];
+            }
+            this->S[k * num_paths + p] = log_S;
+        }
+    }
+    
+    VectorMath::Exp(this->S);
+}
+
+template <class Real>
+BasicOneAssetPathBlock_BS<Real>::BasicOneAssetPathBlock_BS(double S0, double T, double sigma, double r, double q, std::size_t num_paths, std::size_t path_length, const Real* z, const std::vector<std::size_t>& observed) : BasicOneAssetPathBlock<Real>(S0, num_paths, ObservedNodes(observed, path_length).size()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const std::vector<std::size_t> nodes(ObservedNodes(observed, path_length));
+    const double dt = T / path_length;
+    const Real drift = static_cast<Real>((r - q - sigma * sigma / 2.) * dt);
+    const Real vol = static_cast<Real>(sigma * std::sqrt(dt));
+    
+    // Log prices of all paths at the current step
+    // A float sums log(S_t / S0) from 0 instead, so that it keeps its 24 bits for the increments,
+    // and S0 is multiplied in after the exponential
+    constexpr bool from_log_S0 = std::is_same_v<Real, double>;
+    std::vector<Real> log_S(num_paths, from_log_S0 ? static_cast<Real>(std::log(S0)) : Real(0));
+    
+    std::size_t t = 0;
+    for (std::size_t k = 0; k < nodes.size(); k++) {
+        for (; t <= nodes[k]; t++) {
+            const Real* z_row = z + t * num_paths;
+            for (std::size_t p = 0; p < num_paths; p++) {
+                log_S[p] += drift + vol * z_row[p];
+            }
+        }
+        std::copy(log_S.cbegin(), log_S.cend(), this->Step(k));
+    }
+    
+    VectorMath::Exp(this->S);
+    if constexpr (!from_log_S0) {
+        const Real scale = static_cast<Real>(S0);
+        for (Real& s : this->S) {
+            s *= scale;
+        }
+    }
+}
+
+template <class Real>
+BasicOneAssetPathBlock_BS<Real>::BasicOneAssetPathBlock_BS(double S0, const TimeGridIntegrals& grid, const std::vector<std::vector<double>>& z_arr) : BasicOneAssetPathBlock<Real>(S0, z_arr.size(), grid.Steps()) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const std::size_t num_paths = this->num_paths;
+    const double* drift = grid.drift.data();
+    const double* vol = grid.vol.data();
+    const double log_S0 = std::log(S0);
+    
+    for (std::size_t p = 0; p < num_paths; p++) {
+        const std::vector<double>& z_path = z_arr[p];
+        assert(z_path.size() == this->path_length);
+        double log_S = log_S0;
+        for (std::size_t t = 0; t < this->path_length; t++) {
+            log_S += drift[t] + vol[t] * z_path[t];
+            this->S[t * num_paths + p] = log_S;
+        }
+    }
+    
+    VectorMath::Exp(this->S);
+}
+
+template class BasicOneAssetPathBlock_BS<double>;
+template BasicOneAssetPathBlock_BS<float>::BasicOneAssetPathBlock_BS(double S0, double T, double sigma, double r, double q, std::size_t num_paths, std::size_t path_length, const float* z, const std::vector<std::size_t>& observed);
+
+OneAssetExtremeBlock_BS::OneAssetExtremeBlock_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, bool is_max) : OneAssetPathBlock(S0, z_arr.size(), z_arr[0].size()), is_max(is_max), extreme(num_paths * path_length) {
+    MCP_TIME_STAGE(StagePathBuild);
+    
+    const double dt = T / path_length;
+    const double drift = (r - q - sigma * sigma / 2.) * dt;
+    const double vol = sigma * std::sqrt(dt);
+    const double bridge_var = 2. * sigma * sigma * dt;
+    const double sign = is_max ? 1. : -1.;
+    
+    // Log prices, time-major
+    const double log_S0 = std::log(S0);
+    for (std::size_t p = 0; p < num_paths; p++) {
+        const std::vector<double>& z_path = z_arr[p];
+        double log_S = log_S0;
+        for (std::size_t t = 0; t < path_length; t++) {
+            log_S += drift + vol * z_path[t];
+            S[t * num_paths + p] = log_S;
+        }
+    }
+    
+    // Interval extremes in log space, one uniform per step
+    std::vector<double> log_prev(num_paths, log_S0);
+    for (std::size_t t = 0; t < path_length; t++) {
+        const double* log_curr = this->Step(t);
+        double* row = extreme.data() + t * num_paths;
+        for (std::size_t p = 0; p < num_paths; p++) {
+            const double diff = log_curr[p] - log_prev[p];
+            row[p] = (log_prev[p] + log_curr[p] + sign * std::sqrt(diff * diff - bridge_var * std::log(LCE_uniform::gen()))) / 2.;
+        }
+        std::copy(log_curr, log_curr + num_paths, log_prev.begin());
+    }
+    
+    VectorMath::Exp(S);
+    VectorMath::Exp(extreme);
+}
+
+const double* OneAssetExtremeBlock_BS::Extreme(std::size_t t) const {
+    return extreme.data() + t * num_paths;
+}
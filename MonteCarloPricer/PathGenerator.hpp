@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <iostream>
+#include "TermStructure.hpp"
 
 class OneAssetNoPath {
     // One asset
@@ -38,11 +39,58 @@ struct Dividend {
     }
 };
 
+class DividendSchedule {
+    // Proportional and fixed dividends merged into one event list
+    // Compiled once for a given (T, sigma, r, q) and shared by all paths that use it
+private:
+    double T_;
+    double sigma_;
+    double r_;
+    double q_;                          // Continuous yield, on top of the discrete dividends
+    
+    std::vector<double> dividend_value_;
+    std::vector<bool> dividend_is_fixed_;
+    
+    // One entry per interval between events (number of dividends + 1)
+    std::vector<double> time_diff_;
+    std::vector<double> sqrt_time_diff_;
+    std::vector<double> drift_;         // (r - q - sigma^2 / 2) * dt
+    std::vector<double> vol_;           // sigma * sqrt(dt)
+    std::vector<double> multiplier_;    // 1 - d for proportional dividends, 1 otherwise
+    std::vector<double> subtrahend_;    // d for fixed dividends, 0 otherwise
+    
+    // Product of (1 - d) over all proportional dividends
+    double proportional_factor_;
+    
+public:
+    DividendSchedule(double T, double sigma, double r, double q, const Dividend& proportional, const Dividend& fixed);
+    ~DividendSchedule() = default;
+    
+    double T() const { return T_; }
+    double sigma() const { return sigma_; }
+    double r() const { return r_; }
+    double q() const { return q_; }
+    
+    std::size_t Intervals() const { return time_diff_.size(); }
+    
+    const std::vector<double>& DividendValue() const { return dividend_value_; }
+    const std::vector<bool>& DividendIsFixed() const { return dividend_is_fixed_; }
+    const std::vector<double>& TimeDiff() const { return time_diff_; }
+    const std::vector<double>& SqrtTimeDiff() const { return sqrt_time_diff_; }
+    const std::vector<double>& Drift() const { return drift_; }
+    const std::vector<double>& Vol() const { return vol_; }
+    const std::vector<double>& Multiplier() const { return multiplier_; }
+    const std::vector<double>& Subtrahend() const { return subtrahend_; }
+    double ProportionalFactor() const { return proportional_factor_; }
+};
+
 class OneAssetNoPath_BS : public OneAssetNoPath {
     // One asset
     // Log-normal model (Black-Scholes model)
 public:
     OneAssetNoPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<double>& z_arr);
+    // Term-structure parameters, integrated over a one-step grid
+    OneAssetNoPath_BS(double S0, const TimeGridIntegrals& grid, const std::vector<double>& z_arr);
     ~OneAssetNoPath_BS() = default;
 };
 
@@ -63,7 +111,70 @@ class OneAssetWithPath_BS : public OneAssetWithPath {
 public:
     OneAssetWithPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr);
     OneAssetWithPath_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, const Dividend& proportional, const Dividend& fixed);
+    // One node per interval of the schedule
+    OneAssetWithPath_BS(double S0, const std::vector<std::vector<double>>& z_arr, const DividendSchedule& schedule);
+    // Term-structure parameters, one node per step of the grid
+    OneAssetWithPath_BS(double S0, const TimeGridIntegrals& grid, const std::vector<std::vector<double>>& z_arr);
     ~OneAssetWithPath_BS() = default;
 };
 
+template <class Real>
+class BasicOneAssetPathBlock {
+    // One asset
+    // A block of whole paths stored time-major: node t of path p is S[t * num_paths + p]
+    // Real is double, or float for MixedPrecision: twice the lanes per vector and half the bytes per block
+public:
+    double S0;
+    std::size_t num_paths;
+    std::size_t path_length;
+    std::vector<Real> S;
+    
+    BasicOneAssetPathBlock(double S0, std::size_t num_paths, std::size_t path_length);
+    // Transpose path-major paths (one std::vector per path) into a block
+    BasicOneAssetPathBlock(double S0, const std::vector<std::vector<double>>& paths);
+    ~BasicOneAssetPathBlock() = default;
+    
+    // All paths at time step t
+    Real* Step(std::size_t t);
+    const Real* Step(std::size_t t) const;
+};
+
+using OneAssetPathBlock = BasicOneAssetPathBlock<double>;
+
+template <class Real>
+class BasicOneAssetPathBlock_BS : public BasicOneAssetPathBlock<Real> {
+    // One asset
+    // Log-normal model (Black-Scholes model), simulated in log space
+    // Increments are prefix-summed, then only the observed nodes are exponentiated in one batch
+    // observed: sorted indices of the nodes kept in the block (empty: every node)
+    // In float only the time-major constructor is instantiated
+public:
+    // Path-major normals, one std::vector per path (as from StandardGaussianMatrix::gen(num_paths, path_length))
+    BasicOneAssetPathBlock_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, const std::vector<std::size_t>& observed = {});
+    // Time-major normals: z[t * num_paths + p]
+    BasicOneAssetPathBlock_BS(double S0, double T, double sigma, double r, double q, std::size_t num_paths, std::size_t path_length, const Real* z, const std::vector<std::size_t>& observed = {});
+    // Term-structure parameters, one node per step of the grid
+    BasicOneAssetPathBlock_BS(double S0, const TimeGridIntegrals& grid, const std::vector<std::vector<double>>& z_arr);
+    ~BasicOneAssetPathBlock_BS() = default;
+};
+
+using OneAssetPathBlock_BS = BasicOneAssetPathBlock_BS<double>;
+
+class OneAssetExtremeBlock_BS : public OneAssetPathBlock {
+    // One asset
+    // Log-normal model with continuous monitoring: besides the nodes, the extreme of every interval is drawn
+    // from its Brownian-bridge distribution given both endpoints, with one extra uniform per step:
+    // max log S = (x0 + x1 + sqrt((x1 - x0)^2 - 2 sigma^2 dt log U)) / 2, and the root subtracted for the min
+public:
+    bool is_max;                // Sample interval maxima (true) or minima (false)
+    std::vector<double> extreme;    // Extreme over (t - 1, t] of path p at extreme[t * num_paths + p]
+    
+    // Path-major normals; the uniforms are drawn from LCE_uniform after them
+    OneAssetExtremeBlock_BS(double S0, double T, double sigma, double r, double q, const std::vector<std::vector<double>>& z_arr, bool is_max);
+    ~OneAssetExtremeBlock_BS() = default;
+    
+    // Interval extremes of all paths at time step t
+    const double* Extreme(std::size_t t) const;
+};
+
 #endif /* PathGenerator_hpp */
@@ -0,0 +1,225 @@
+//
+//  PricingServer.cpp
+//  MonteCarloPricer
+//
+
+#include "PricingServer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "TradeFile.hpp"
+
+struct PricingServer::Connection {
+    int in_fd;
+    int out_fd;
+    bool owns_fd;           // Socket connections close on the last reference
+    
+    std::mutex write_mutex;
+    std::mutex mutex;
+    std::condition_variable answered;
+    std::size_t outstanding = 0;    // Requests read and not answered
+    std::size_t requests = 0;       // Read so far
+    
+    Connection(int in_fd, int out_fd, bool owns_fd) : in_fd(in_fd), out_fd(out_fd), owns_fd(owns_fd) {}
+    ~Connection() {
+        if (owns_fd) ::close(in_fd);
+    }
+    
+    void Answer(const std::string& text) {
+        {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            const char* data = text.data();
+            std::size_t left = text.size();
+            while (left > 0) {
+                ssize_t n = ::write(out_fd, data, left);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;  // Peer gone: drop the answer
+                data += n;
+                left -= static_cast<std::size_t>(n);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--outstanding == 0) answered.notify_all();
+    }
+};
+
+namespace {
+
+struct Batch {
+    std::vector<std::size_t> request_of;    // Request of every trade
+    std::vector<Trade> trades;              // Views into the request lines
+};
+
+std::string Escape(std::string_view s) {
+    std::string res;
+    for (char c : s) {
+        if (c == '"' || c == '\\') res.push_back('\\');
+        res.push_back(c);
+    }
+    return res;
+}
+
+std::string AnswerText(std::string_view id, const TradeResult& res) {
+    std::string text = "{\"id\": \"" + Escape(id) + "\", ";
+    if (res.error.empty()) {
+        char numbers[96];
+        std::snprintf(numbers, sizeof(numbers), "\"value\": %.10g, \"std_error\": %.10g}\n", res.value, res.std_error);
+        text += numbers;
+    } else {
+        text += "\"error\": \"" + Escape(res.error) + "\"}\n";
+    }
+    return text;
+}
+
+}
+
+PricingServer::PricingServer(unsigned num_threads, std::size_t cache_bytes, std::size_t block_size, const std::string& cache_directory) : cache_(cache_bytes), results_(1 << 20, cache_directory), pricer_(block_size, &cache_, &results_), pool_(num_threads), stop_(false) {
+    dispatcher_ = std::thread(&PricingServer::Dispatch, this);
+}
+
+PricingServer::~PricingServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queued_.notify_all();
+    dispatcher_.join();
+    pool_.Wait();
+}
+
+void PricingServer::Dispatch() {
+    while (true) {
+        std::vector<Request> requests;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            
+            // Hold back while every worker is busy, letting the batch grow
+            while (!stop_ && pool_.Pending() >= pool_.NumThreads()) {
+                queued_.wait_for(lock, std::chrono::microseconds(50));
+            }
+            requests.swap(queue_);
+        }
+        
+        // The lines stay put from here on: the trades view them
+        auto lines = std::make_shared<std::vector<Request>>(std::move(requests));
+        auto batch = std::make_shared<Batch>();
+        for (std::size_t i = 0; i < lines->size(); i++) {
+            try {
+                const Request& request = (*lines)[i];
+                if (request.line.find("\"invalidate\"") != std::string::npos) {
+                    auto fields = TradeFile::ParseJSONObject(request.line, request.number);
+                    auto field = std::find_if(fields.cbegin(), fields.cend(), [](const auto& field) { return field.first == "invalidate"; });
+                    if (field != fields.cend()) {
+                        results_.Invalidate(field->second);
+                        request.connection->Answer("{\"invalidated\": \"" + Escape(field->second) + "\"}\n");
+                        continue;
+                    }
+                }
+                batch->trades.push_back(TradeFile::ParseJSONLine(request.line, request.number));
+                batch->request_of.push_back(i);
+            } catch (const std::exception& e) {
+                (*lines)[i].connection->Answer("{\"error\": \"" + Escape(e.what()) + "\"}\n");
+            }
+        }
+        
+        for (std::vector<std::size_t>& group : TradePricer::Group(batch->trades)) {
+            pool_.Submit([this, lines, batch, group = std::move(group)] {
+                for (const TradeResult& res : pricer_.PriceGroup(batch->trades, group)) {
+                    const Request& request = (*lines)[batch->request_of[res.index]];
+                    request.connection->Answer(AnswerText(batch->trades[res.index].id, res));
+                }
+            });
+        }
+    }
+}
+
+void PricingServer::Read(const std::shared_ptr<Connection>& connection) {
+    std::string buffer;
+    char chunk[1 << 16];
+    bool open = true;
+    
+    while (open) {
+        ssize_t n = ::read(connection->in_fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n > 0) {
+            buffer.append(chunk, static_cast<std::size_t>(n));
+        } else {
+            // A last line without a newline still counts
+            open = false;
+            buffer.push_back('\n');
+        }
+        
+        // Every complete line read so far goes out as one lot
+        std::vector<Request> requests;
+        std::size_t start = 0;
+        std::size_t end;
+        // Counted before they can be answered
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        while ((end = buffer.find('\n', start)) != std::string::npos) {
+            connection->requests++;
+            if (buffer.find_first_not_of(" \t\r", start) < end) {
+                requests.push_back(Request({connection, connection->requests, buffer.substr(start, end - start)}));
+            }
+            start = end + 1;
+        }
+        buffer.erase(0, start);
+        if (requests.empty()) continue;
+        
+        connection->outstanding += requests.size();
+        {
+            std::lock_guard<std::mutex> queue_lock(mutex_);
+            for (Request& request : requests) {
+                queue_.push_back(std::move(request));
+            }
+        }
+        queued_.notify_one();
+    }
+}
+
+void PricingServer::ServeStream(int in_fd, int out_fd) {
+    auto connection = std::make_shared<Connection>(in_fd, out_fd, false);
+    this->Read(connection);
+    
+    std::unique_lock<std::mutex> lock(connection->mutex);
+    connection->answered.wait(lock, [&connection] { return connection->outstanding == 0; });
+}
+
+void PricingServer::ServeSocket(const std::string& path) {
+    // Clients that hang up must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("socket path too long: " + path);
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) throw std::runtime_error("cannot create socket");
+    ::unlink(path.c_str());
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 128) != 0) {
+        ::close(listener);
+        throw std::runtime_error("cannot listen on " + path + ": " + std::strerror(errno));
+    }
+    
+    while (true) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            // Out of descriptors and the like: back off and keep serving the others
+            if (errno != EINTR && errno != ECONNABORTED) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        
+        auto connection = std::make_shared<Connection>(fd, fd, true);
+        std::thread([this, connection] { this->Read(connection); }).detach();
+    }
+}
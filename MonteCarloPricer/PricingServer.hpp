@@ -0,0 +1,70 @@
+//
+//  PricingServer.hpp
+//  MonteCarloPricer
+//
+
+#ifndef PricingServer_hpp
+#define PricingServer_hpp
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ResultCache.hpp"
+#include "SimulationCache.hpp"
+#include "ThreadPool.hpp"
+#include "TradePricer.hpp"
+
+class PricingServer {
+    // Long-running pricer over pipes or a Unix domain socket
+    // A request is one JSON line (a trade, keys as in TradeFile); each answer is one JSON line,
+    //  {"id": ..., "value": ..., "std_error": ...} or {"id": ..., "error": ...},
+    // written as soon as its group finishes, so answers may come back out of order.
+    // Readers queue requests; one dispatcher takes everything queued, groups it across connections
+    // (requests on the same simulation share one) and hands the groups to the pool. While all workers are busy
+    // the dispatcher holds back, so batches grow with the load and an idle server answers without delay.
+    // Normals and dividend schedules stay in a SimulationCache for the life of the server, and answers in a ResultCache
+    // (optionally on disk). {"invalidate": "<underlying>"} drops the cached answers on that underlying once its market
+    // inputs change and is acknowledged with {"invalidated": "<underlying>"}.
+private:
+    struct Connection;
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        std::size_t number;         // Line number on the connection
+        std::string line;
+    };
+    
+    SimulationCache cache_;
+    ResultCache results_;
+    TradePricer pricer_;
+    ThreadPool pool_;
+    
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::vector<Request> queue_;
+    bool stop_;
+    std::thread dispatcher_;
+    
+    void Dispatch();
+    // Queue the lines of one connection until end of input
+    void Read(const std::shared_ptr<Connection>& connection);
+    
+public:
+    // cache_directory: disk tier of the result cache (empty: memory only)
+    PricingServer(unsigned num_threads = 0, std::size_t cache_bytes = std::size_t(1) << 28, std::size_t block_size = 1 << 13, const std::string& cache_directory = "");
+    PricingServer(const PricingServer&) = delete;
+    PricingServer& operator = (const PricingServer&) = delete;
+    ~PricingServer();
+    
+    // Serve one stream (e.g. stdin and stdout); returns at end of input once every answer is written
+    void ServeStream(int in_fd, int out_fd);
+    // Accept connections on a Unix domain socket, one reader thread each; returns only on error (std::runtime_error)
+    void ServeSocket(const std::string& path);
+    
+    const SimulationCache& Cache() const { return cache_; }
+    const ResultCache& Results() const { return results_; }
+};
+
+#endif /* PricingServer_hpp */
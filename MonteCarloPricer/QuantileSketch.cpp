@@ -0,0 +1,287 @@
+//
+//  QuantileSketch.cpp
+//  MonteCarloPricer
+//
+
+#include "QuantileSketch.hpp"
+#include "Instrumentation.hpp"
+#include "Serialization.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+QuantileSketch::QuantileSketch(double compression) : compression_(compression), buffer_capacity_(static_cast<std::size_t>(10. * compression)), total_weight_(0.), min_(std::numeric_limits<double>::infinity()), max_(-std::numeric_limits<double>::infinity()) {
+    buffer_.reserve(buffer_capacity_);
+}
+
+void QuantileSketch::Add(double x, double weight) {
+    buffer_.push_back({x, weight});
+    min_ = std::min(min_, x);
+    max_ = std::max(max_, x);
+    
+    if (buffer_.size() >= buffer_capacity_) this->Flush();
+}
+
+void QuantileSketch::Add(const double* x, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        this->Add(x[i]);
+    }
+}
+
+double QuantileSketch::Compress(std::vector<Centroid>& points, double compression, std::vector<Centroid>& centroids) {
+    // All centroids, old and new, sorted by mean
+    std::sort(points.begin(), points.end(), [](const Centroid& a, const Centroid& b)->bool { return a.mean < b.mean; });
+    
+    double total = 0.;
+    for (const Centroid& c : points) {
+        total += c.weight;
+    }
+    
+    // Scale function and its inverse
+    const double normalizer = compression / (4. * std::log(std::max(total / compression, 1.)) + 24.);
+    auto k = [=](double q)->double { return normalizer * std::log(q / (1. - q)); };
+    auto k_inv = [=](double k)->double { return 1. / (1. + std::exp(-k / normalizer)); };
+    
+    // Greedy merge: a centroid grows while it spans at most one unit of k
+    centroids.clear();
+    Centroid curr = points[0];
+    double weight_so_far = 0.;
+    double q_limit = k_inv(k(0.) + 1.) * total;
+    for (std::size_t i = 1; i < points.size(); i++) {
+        const Centroid& next = points[i];
+        if (weight_so_far + curr.weight + next.weight <= q_limit) {
+            curr.weight += next.weight;
+            curr.mean += (next.mean - curr.mean) * next.weight / curr.weight;
+        } else {
+            weight_so_far += curr.weight;
+            centroids.push_back(curr);
+            q_limit = k_inv(k(weight_so_far / total) + 1.) * total;
+            curr = next;
+        }
+    }
+    centroids.push_back(curr);
+    
+    return total;
+}
+
+void QuantileSketch::Flush() {
+    if (buffer_.empty()) return;
+    buffer_.insert(buffer_.end(), centroids_.cbegin(), centroids_.cend());
+    total_weight_ = Compress(buffer_, compression_, centroids_);
+    buffer_.clear();
+}
+
+const std::vector<Centroid>& QuantileSketch::Centroids(std::vector<Centroid>& scratch, double& total) const {
+    if (buffer_.empty()) {
+        total = total_weight_;
+        return centroids_;
+    }
+    std::vector<Centroid> points(buffer_);
+    points.insert(points.end(), centroids_.cbegin(), centroids_.cend());
+    total = Compress(points, compression_, scratch);
+    return scratch;
+}
+
+void QuantileSketch::Merge(const QuantileSketch& other) {
+    buffer_.insert(buffer_.end(), other.centroids_.cbegin(), other.centroids_.cend());
+    buffer_.insert(buffer_.end(), other.buffer_.cbegin(), other.buffer_.cend());
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    this->Flush();
+}
+
+namespace {
+
+// (mean, weight) pairs, flattened
+void PutCentroids(ByteWriter& writer, const std::vector<Centroid>& centroids) {
+    std::vector<double> flat;
+    flat.reserve(2 * centroids.size());
+    for (const Centroid& c : centroids) {
+        flat.push_back(c.mean);
+        flat.push_back(c.weight);
+    }
+    writer.PutDoubles(flat);
+}
+
+std::vector<Centroid> GetCentroids(ByteReader& reader) {
+    const std::vector<double> flat(reader.GetDoubles());
+    if (flat.size() % 2 != 0) throw std::runtime_error("serialized QuantileSketch has an odd centroid array");
+    std::vector<Centroid> centroids(flat.size() / 2);
+    for (std::size_t i = 0; i < centroids.size(); i++) {
+        centroids[i] = {flat[2 * i], flat[2 * i + 1]};
+    }
+    return centroids;
+}
+
+}
+
+void QuantileSketch::Save(ByteWriter& writer) const {
+    writer.PutDouble(compression_);
+    writer.PutDouble(total_weight_);
+    writer.PutDouble(min_);
+    writer.PutDouble(max_);
+    PutCentroids(writer, centroids_);
+    PutCentroids(writer, buffer_);
+}
+
+QuantileSketch QuantileSketch::Load(ByteReader& reader) {
+    QuantileSketch res(reader.GetDouble());
+    res.total_weight_ = reader.GetDouble();
+    res.min_ = reader.GetDouble();
+    res.max_ = reader.GetDouble();
+    res.centroids_ = GetCentroids(reader);
+    std::vector<Centroid> buffer(GetCentroids(reader));
+    res.buffer_.insert(res.buffer_.end(), buffer.cbegin(), buffer.cend());
+    return res;
+}
+
+double QuantileSketch::Count() const {
+    double total_weight = total_weight_;
+    for (const Centroid& c : buffer_) {
+        total_weight += c.weight;
+    }
+    return total_weight;
+}
+
+std::size_t QuantileSketch::NumCentroids() const {
+    std::vector<Centroid> scratch;
+    double total_weight;
+    const std::vector<Centroid>& centroids = this->Centroids(scratch, total_weight);
+    return centroids.size();
+}
+
+double QuantileSketch::Quantile(double q) const {
+    std::vector<Centroid> scratch;
+    double total_weight;
+    const std::vector<Centroid>& centroids = this->Centroids(scratch, total_weight);
+    if (centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+    
+    // Piecewise linear through (0, min), the centroid midpoints (cumulative weight, mean), and (total, max)
+    const double index = q * total_weight;
+    double prev_x = 0.;
+    double prev_y = min_;
+    double cumulative = 0.;
+    for (const Centroid& c : centroids) {
+        const double x = cumulative + c.weight / 2.;
+        if (index < x) {
+            return prev_y + (c.mean - prev_y) * (index - prev_x) / (x - prev_x);
+        }
+        prev_x = x;
+        prev_y = c.mean;
+        cumulative += c.weight;
+    }
+    
+    if (total_weight <= prev_x) return max_;
+    return prev_y + (max_ - prev_y) * std::min((index - prev_x) / (total_weight - prev_x), 1.);
+}
+
+double QuantileSketch::UpperTailMean(double q) const {
+    std::vector<Centroid> scratch;
+    double total_weight;
+    const std::vector<Centroid>& centroids = this->Centroids(scratch, total_weight);
+    if (centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+    
+    // Take the tail mass from the largest centroids down, the last one in part
+    double mass = (1. - q) * total_weight;
+    const double tail_mass = mass;
+    double sum = 0.;
+    for (auto c = centroids.crbegin(); c != centroids.crend() && mass > 0.; c++) {
+        const double w = std::min(c->weight, mass);
+        sum += w * c->mean;
+        mass -= w;
+    }
+    
+    return sum / tail_mass;
+}
+
+double QuantileSketch::LowerTailMean(double q) const {
+    std::vector<Centroid> scratch;
+    double total_weight;
+    const std::vector<Centroid>& centroids = this->Centroids(scratch, total_weight);
+    if (centroids.empty()) return std::numeric_limits<double>::quiet_NaN();
+    
+    // Take the tail mass from the smallest centroids up, the last one in part
+    double mass = q * total_weight;
+    const double tail_mass = mass;
+    double sum = 0.;
+    for (auto c = centroids.cbegin(); c != centroids.cend() && mass > 0.; c++) {
+        const double w = std::min(c->weight, mass);
+        sum += w * c->mean;
+        mass -= w;
+    }
+    
+    return sum / tail_mass;
+}
+
+PayoffDistribution::PayoffDistribution(double compression) : sketch_(compression) {}
+
+void PayoffDistribution::Add(double x) {
+    moments_.Add(x);
+    sketch_.Add(x);
+}
+
+void PayoffDistribution::Add(const double* x, std::size_t n) {
+    moments_.Add(x, n);
+    sketch_.Add(x, n);
+}
+
+void PayoffDistribution::Merge(const PayoffDistribution& other) {
+    moments_.Merge(other.moments_);
+    sketch_.Merge(other.sketch_);
+}
+
+void PayoffDistribution::Print(const std::vector<double>& levels) const {
+    std::cout << this->Mean() << '\t' << this->StdError() << std::endl;
+    for (double q : levels) {
+        std::cout << q << '\t' << sketch_.Quantile(q) << '\t' << sketch_.LowerTailMean(q) << '\t' << sketch_.UpperTailMean(q) << std::endl;
+    }
+}
+
+PayoffDistribution PayoffDistribution::Accumulate(const std::vector<double>& x, unsigned num_threads, double compression) {
+    DistributionAccumulator accumulator(num_threads, compression);
+    accumulator.Add(x);
+    return accumulator.Result();
+}
+
+DistributionAccumulator::DistributionAccumulator(unsigned num_threads, double compression) : compression_(compression), total_(compression) {
+    if (num_threads == 0) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    if (num_threads > 1) pool_ = std::make_unique<ThreadPool>(num_threads);
+}
+
+DistributionAccumulator::~DistributionAccumulator() = default;
+
+void DistributionAccumulator::Add(const std::vector<double>& x) {
+    MCP_TIME_STAGE(StageReduction);
+    const std::size_t N = x.size();
+    const std::size_t num_chunks = (N + accumulate_chunk - 1) / accumulate_chunk;
+    
+    std::vector<PayoffDistribution> partial(num_chunks, PayoffDistribution(compression_));
+    auto AddChunk = [this, &x, &partial, N](std::size_t c) {
+        const std::size_t begin = c * accumulate_chunk;
+        const std::size_t end = std::min(N, begin + accumulate_chunk);
+        partial[c].Add(x.data() + begin, end - begin);
+    };
+    
+    if (pool_ && num_chunks > 1) {
+        for (std::size_t c = 0; c < num_chunks; c++) {
+            pool_->Submit([&AddChunk, c] { AddChunk(c); });
+        }
+        pool_->Wait();
+    } else {
+        for (std::size_t c = 0; c < num_chunks; c++) {
+            AddChunk(c);
+        }
+    }
+    
+    for (const PayoffDistribution& distribution : partial) {
+        total_.Merge(distribution);
+    }
+}
+
+PayoffDistribution DistributionAccumulator::Result() const {
+    return total_;
+}
@@ -0,0 +1,127 @@
+//
+//  QuantileSketch.hpp
+//  MonteCarloPricer
+//
+
+#ifndef QuantileSketch_hpp
+#define QuantileSketch_hpp
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "Statistics.hpp"
+
+class ByteWriter;
+class ByteReader;
+class ThreadPool;
+
+struct Centroid {
+    double mean;
+    double weight;
+};
+
+class QuantileSketch {
+    // Merging t-digest (Dunning & Ertl)
+    // Samples are buffered, then sorted and merged into centroids whose weight is bounded by the scale function
+    // k(q) = compression / Z * log(q / (1 - q)), Z = 4 log(n / compression) + 24,
+    // so centroids near both tails stay small and tail quantiles keep their relative accuracy.
+    // Memory is O(compression) whatever the number of samples; sketches merge by re-merging their centroids.
+private:
+    double compression_;
+    std::size_t buffer_capacity_;
+    
+    // Samples are merged when the buffer fills and on Merge; queries never modify the sketch
+    // (a query with samples still buffered merges them into a copy), so const sketches can be read from any thread
+    std::vector<Centroid> centroids_;   // Sorted by mean
+    std::vector<Centroid> buffer_;      // Not yet merged
+    double total_weight_;               // Of centroids_
+    
+    double min_;
+    double max_;
+    
+    // Merges points (sorted in place) into centroids; returns their total weight
+    static double Compress(std::vector<Centroid>& points, double compression, std::vector<Centroid>& centroids);
+    void Flush();
+    // The centroids with the buffer merged in: centroids_ if nothing is buffered, else a merged copy in scratch
+    const std::vector<Centroid>& Centroids(std::vector<Centroid>& scratch, double& total) const;
+    
+public:
+    QuantileSketch(double compression = 1000.);
+    ~QuantileSketch() = default;
+    
+    void Add(double x, double weight = 1.);
+    void Add(const double* x, std::size_t n);
+    
+    void Merge(const QuantileSketch& other);
+    
+    // Exact state, buffer included, so that a sketch read back merges and answers as the one written
+    void Save(ByteWriter& writer) const;
+    static QuantileSketch Load(ByteReader& reader);
+    
+    double Count() const;
+    double Min() const { return min_; }
+    double Max() const { return max_; }
+    std::size_t NumCentroids() const;
+    
+    // Value below which a fraction q of the samples lies
+    double Quantile(double q) const;
+    
+    // Expected shortfall: mean of the samples above the q-quantile (upper tail) or below it (lower tail)
+    double UpperTailMean(double q) const;
+    double LowerTailMean(double q) const;
+};
+
+class PayoffDistribution {
+    // Mean and variance (Welford) together with a quantile sketch of the same samples
+    // e.g. discounted payoffs or P&L of a position, for VaR and expected shortfall next to the price
+private:
+    RunningStatistics moments_;
+    QuantileSketch sketch_;
+    
+public:
+    PayoffDistribution(double compression = 1000.);
+    ~PayoffDistribution() = default;
+    
+    void Add(double x);
+    void Add(const double* x, std::size_t n);
+    
+    // Exact for the moments (Chan et al.), centroid re-merge for the sketch
+    void Merge(const PayoffDistribution& other);
+    
+    std::size_t Count() const { return moments_.Count(); }
+    double Mean() const { return moments_.Mean(); }
+    double Variance() const { return moments_.Variance(); }
+    double StdError() const { return moments_.StdError(); }
+    const QuantileSketch& Sketch() const { return sketch_; }
+    
+    // Mean, standard error, then quantile, lower and upper tail mean at each level
+    void Print(const std::vector<double>& levels = {.001, .01, .99, .999}) const;
+    
+    // Accumulates x on num_threads threads (one distribution per fixed chunk) and merges in chunk order
+    static PayoffDistribution Accumulate(const std::vector<double>& x, unsigned num_threads = 0, double compression = 1000.);
+};
+
+class DistributionAccumulator {
+    // A PayoffDistribution fed block after block: every block is cut into fixed chunks of accumulate_chunk samples,
+    // each chunk gets its own distribution, and those merge into the total in chunk order.
+    // The threads are started once per accumulator, not once per block, and only decide who runs the chunks,
+    // so the result is the same for every thread count.
+private:
+    double compression_;
+    PayoffDistribution total_;
+    std::unique_ptr<ThreadPool> pool_;  // None for a single thread
+    
+public:
+    DistributionAccumulator(unsigned num_threads = 0, double compression = 1000.);   // 0: hardware concurrency
+    ~DistributionAccumulator();
+    
+    // As ControlVariateEstimator::Accumulate
+    static constexpr std::size_t accumulate_chunk = 1 << 16;
+    
+    // Returns once the whole block is accumulated, so x may be reused
+    void Add(const std::vector<double>& x);
+    
+    PayoffDistribution Result() const;
+};
+
+#endif /* QuantileSketch_hpp */
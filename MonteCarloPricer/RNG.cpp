@@ -6,6 +6,10 @@
 //
 
 #include "RNG.hpp"
+#include "Instrumentation.hpp"
+#include <cassert>
+#include <cmath>
+#include <tuple>
 
 //thread_local std::random_device LCE_uniform::rv_ = std::random_device();
 //thread_local std::mt19937 LCE_uniform::eng_ = std::mt19937(LCE_uniform::rv_());
@@ -23,12 +27,14 @@ thread_local unsigned long LCE_uniform::r_ = k_ % a_;
 
 // Initial state
 thread_local unsigned long LCE_uniform::state_ = 1;
+thread_local unsigned long long LCE_uniform::draws_ = 0;
 
 double LCE_uniform::gen() {
     
     state_ = static_cast<unsigned long>(static_cast<unsigned long long>(a_) * static_cast<unsigned long long>(state_) % k_);
     state_ += c_ % k_;
     state_ %= k_;
+    draws_++;
     
     return double(state_) / k_;
 }
@@ -37,6 +43,29 @@ void LCE_uniform::reseed(unsigned long new_seed) {
     state_ = new_seed;
 }
 
+unsigned long LCE_uniform::state() {
+    return state_;
+}
+
+unsigned long LCE_uniform::skip(unsigned long state, unsigned long long n) {
+    assert(c_ == 0);
+    unsigned long long res = state % k_;
+    unsigned long long power = a_;
+    for (n %= (k_ - 1); n > 0; n >>= 1) {
+        if (n & 1) res = res * power % k_;
+        power = power * power % k_;
+    }
+    return static_cast<unsigned long>(res);
+}
+
+unsigned long LCE_uniform::period() {
+    return k_ - 1;
+}
+
+unsigned long long LCE_uniform::draws() {
+    return draws_;
+}
+
 thread_local const double BSM::a0_ =   2.50662823884;
 thread_local const double BSM::a1_ = -18.61500062529;
 thread_local const double BSM::a2_ =  41.39119773534;
@@ -89,6 +118,7 @@ double Rejection::standard_normal() {
     
     if (u2 > std::exp(-(x - 1.) * (x - 1.) / 2.)) {
         // Reject
+        MCP_COUNT(CountRejectionRejections, 1);
         return Rejection::standard_normal();
     } else {
         // Accept
@@ -104,6 +134,7 @@ std::pair<double, double> MarsagliaBray::standard_normal_pair() {
         u1 = 2. * LCE_uniform::gen() - 1.;
         u2 = 2. * LCE_uniform::gen() - 1.;
         X = u1 * u1 + u2 * u2;
+        MCP_COUNT(CountMarsagliaBrayRejections, X > 1);
     } while (X > 1);
     
     double Y = std::sqrt(-2. * std::log(X) / X);
@@ -145,6 +176,10 @@ void Rng::reseed(unsigned new_seed) {
 //}
 
 std::vector<double> StandardGaussianMatrix::gen(std::size_t size) {
+    MCP_TIME_STAGE(StageRNG);
+    MCP_COUNT(CountNormalsDrawn, size);
+    MCP_COUNT(CountBytesAllocated, size * sizeof(double));
+    
     assert(size % 2 == 0);
     std::vector<double> z(size);
 
@@ -162,6 +197,7 @@ std::vector<double> StandardGaussianMatrix::gen(std::size_t size) {
 }
 
 std::vector<std::vector<double>> StandardGaussianMatrix::gen(std::size_t rows, std::size_t cols) {
+    MCP_TIME_STAGE(StageRNG);
     std::vector<std::vector<double>> z;
     if (cols % 2 == 0) {
         for (std::size_t i = 0; i < rows; i++) {
@@ -23,6 +23,7 @@ private:
     static thread_local unsigned long r_;
     
     static thread_local unsigned long state_;
+    static thread_local unsigned long long draws_;
     
     // For testing only
 //    static thread_local std::random_device rv_;
@@ -40,6 +41,17 @@ public:
     static double gen();
     
     static void reseed(unsigned long new_seed);
+    
+    // Current position of the generator; reseed(state()) resumes the sequence from here
+    static unsigned long state();
+    
+    // The position n draws after state: a^n state mod k (c is 0), by repeated squaring,
+    // so that streams far apart can be started without drawing through them
+    static unsigned long skip(unsigned long state, unsigned long long n);
+    // Length of the sequence before it repeats (k - 1, from any seed in [1, k - 1])
+    static unsigned long period();
+    // Numbers generated on this thread so far (reseed does not reset it); differences count the draws of a computation
+    static unsigned long long draws();
 };
 
 class BSM {
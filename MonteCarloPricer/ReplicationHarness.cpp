@@ -0,0 +1,55 @@
+//
+//  ReplicationHarness.cpp
+//  MonteCarloPricer
+//
+
+#include "ReplicationHarness.hpp"
+#include "Statistics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+ReplicationHarness::ReplicationHarness(unsigned num_threads) : num_threads_(num_threads ? num_threads : std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+ReplicationResults ReplicationHarness::Run(const std::function<double (unsigned long)>& estimator, std::size_t replications, unsigned long first_seed, std::size_t paths_per_replication) const {
+    
+    const auto start = std::chrono::steady_clock::now();
+    
+    std::vector<double> estimates(replications);
+    std::atomic<std::size_t> next(0);
+    
+    auto Worker = [&]() {
+        for (std::size_t i = next++; i < replications; i = next++) {
+            estimates[i] = estimator(first_seed + i);
+        }
+    };
+    
+    const unsigned num_threads = static_cast<unsigned>(std::min<std::size_t>(num_threads_, std::max<std::size_t>(replications, 1)));
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; t++) {
+        threads.emplace_back(Worker);
+    }
+    Worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    // Merge in index order
+    RunningStatistics stats;
+    stats.Add(estimates.data(), estimates.size());
+    
+    ReplicationResults res;
+    res.replications = replications;
+    res.mean = stats.Mean();
+    res.stdev = stats.StdDev();
+    res.std_error = stats.StdError();
+    res.seconds = seconds;
+    res.replications_per_second = replications / seconds;
+    res.paths_per_second = paths_per_replication * replications / seconds;
+    res.estimates = std::move(estimates);
+    
+    return res;
+}
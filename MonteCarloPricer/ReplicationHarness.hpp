@@ -0,0 +1,43 @@
+//
+//  ReplicationHarness.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ReplicationHarness_hpp
+#define ReplicationHarness_hpp
+
+#include <functional>
+#include <iostream>
+#include <vector>
+
+struct ReplicationResults {
+    std::size_t replications;
+    double mean;                    // Of the replication estimates
+    double stdev;
+    double std_error;               // Of the mean
+    double seconds;                 // Wall-clock time
+    double replications_per_second;
+    double paths_per_second;        // 0 unless the paths per replication are given
+    std::vector<double> estimates;  // By replication index
+    
+    void Print() const {
+        std::cout << mean << '\t' << stdev << '\t' << std_error << '\t' << seconds << '\t' << replications_per_second << '\t' << paths_per_second << std::endl;
+    }
+};
+
+class ReplicationHarness {
+    // Runs independent replications of an estimator over a pool of threads
+    // Replication i uses seed first_seed + i. Threads pull the next index as they finish (uneven replications balance),
+    // estimates are stored by index and merged with Welford in index order, so the results do not depend on the thread count.
+    // The estimator may only rely on thread-local generator state (LCE_uniform is thread_local) and must be safe to call concurrently.
+private:
+    unsigned num_threads_;
+    
+public:
+    ReplicationHarness(unsigned num_threads = 0);   // 0: hardware concurrency
+    ~ReplicationHarness() = default;
+    
+    ReplicationResults Run(const std::function<double (unsigned long)>& estimator, std::size_t replications, unsigned long first_seed = 1, std::size_t paths_per_replication = 0) const;
+};
+
+#endif /* ReplicationHarness_hpp */
@@ -0,0 +1,285 @@
+//
+//  ResultCache.cpp
+//  MonteCarloPricer
+//
+
+#include "ResultCache.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <unistd.h>
+
+namespace {
+
+const char magic[8] = {'M', 'C', 'P', 'R', 'C', '0', '0', '1'};
+
+// Records: magic, key size, key, value count, values
+std::string Record(const std::string& key, const std::vector<double>& values) {
+    const std::uint64_t key_size = key.size();
+    const std::uint64_t count = values.size();
+    std::string record(magic, sizeof(magic));
+    record.append(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+    record.append(key);
+    record.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    record.append(reinterpret_cast<const char*>(values.data()), count * sizeof(double));
+    return record;
+}
+
+// Calls on_record(key, values) for every whole record of a log, in order; a torn last record is ignored
+void ParseLog(const std::string& log, const std::function<void (std::string&&, std::vector<double>&&)>& on_record) {
+    std::size_t pos = 0;
+    while (log.size() - pos >= sizeof(magic) + 2 * sizeof(std::uint64_t) && std::memcmp(log.data() + pos, magic, sizeof(magic)) == 0) {
+        std::uint64_t key_size;
+        std::memcpy(&key_size, log.data() + pos + sizeof(magic), sizeof(key_size));
+        const std::size_t key_pos = pos + sizeof(magic) + sizeof(key_size);
+        if (log.size() - key_pos < key_size + sizeof(std::uint64_t)) break;
+        
+        std::uint64_t count;
+        std::memcpy(&count, log.data() + key_pos + key_size, sizeof(count));
+        const std::size_t values_pos = key_pos + key_size + sizeof(count);
+        if ((log.size() - values_pos) / sizeof(double) < count) break;
+        
+        std::vector<double> values(count);
+        std::memcpy(values.data(), log.data() + values_pos, count * sizeof(double));
+        on_record(log.substr(key_pos, key_size), std::move(values));
+        pos = values_pos + count * sizeof(double);
+    }
+}
+
+std::string Hex(std::uint64_t n) {
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(n));
+    return buffer;
+}
+
+}
+
+CacheKey::CacheKey(std::string_view method) {
+    this->Add(method);
+}
+
+CacheKey& CacheKey::Add(double x) {
+    // +0 and -0 differ in bits but not as inputs
+    if (x == 0.) x = 0.;
+    char bytes[sizeof(double)];
+    std::memcpy(bytes, &x, sizeof(double));
+    bytes_.append(bytes, sizeof(double));
+    return *this;
+}
+
+CacheKey& CacheKey::Add(std::uint64_t n) {
+    char bytes[sizeof(std::uint64_t)];
+    std::memcpy(bytes, &n, sizeof(std::uint64_t));
+    bytes_.append(bytes, sizeof(std::uint64_t));
+    return *this;
+}
+
+CacheKey& CacheKey::Add(std::string_view s) {
+    this->Add(static_cast<std::uint64_t>(s.size()));
+    bytes_.append(s.data(), s.size());
+    return *this;
+}
+
+std::uint64_t CacheKey::Hash() const {
+    return CacheKey::FNV1a(bytes_);
+}
+
+std::uint64_t CacheKey::FNV1a(std::string_view bytes) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ResultCache::ResultCache(std::size_t max_entries, const std::string& directory) : max_entries_(max_entries), directory_(directory), hits_(0), disk_hits_(0), misses_(0) {
+    if (!directory_.empty()) std::filesystem::create_directories(directory_);
+}
+
+std::string ResultCache::LogPath(std::string_view tag) const {
+    return directory_ + "/" + Hex(CacheKey::FNV1a(tag)) + ".log";
+}
+
+void ResultCache::Insert(const std::string& key, std::string_view tag, const std::vector<double>& values) {
+    // Under the lock
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        it->second.values = values;
+        lru_.splice(lru_.begin(), lru_, it->second.position);
+        return;
+    }
+    
+    while (entries_.size() >= max_entries_ && !lru_.empty()) {
+        // Only the evicted entry's tag has lost part of its log
+        auto evicted = entries_.find(lru_.back());
+        loaded_.erase(evicted->second.tag);
+        entries_.erase(evicted);
+        lru_.pop_back();
+    }
+    lru_.push_front(key);
+    entries_.emplace(key, Entry({std::string(tag), values, lru_.begin()}));
+}
+
+void ResultCache::Load(std::string_view tag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!loaded_.insert(std::string(tag)).second) return;
+    }
+    
+    const std::string log(this->ReadLog(tag));
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    ParseLog(log, [this, tag](std::string&& key, std::vector<double>&& values) {
+        this->Insert(key, tag, values);
+    });
+    this->Compact(tag, log);
+}
+
+std::string ResultCache::ReadLog(std::string_view tag) const {
+    std::ifstream file(this->LogPath(tag), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+void ResultCache::Compact(std::string_view tag, const std::string& log) {
+    // Under the lock. Superseded records, and keys too old to fit in memory anyway, are dropped once they make up
+    // half the log. Appends also hold the lock, so none is lost; the rename swaps the whole file for other readers.
+    appended_[std::string(tag)] = 0;
+    
+    // Latest record of each key, with the position of that record
+    std::unordered_map<std::string, std::pair<std::size_t, std::vector<double>>, Hasher> latest;
+    std::size_t records = 0;
+    ParseLog(log, [&latest, &records](std::string&& key, std::vector<double>&& values) {
+        latest[std::move(key)] = std::make_pair(records++, std::move(values));
+    });
+    if (records < 64 || records <= 2 * std::min(latest.size(), max_entries_)) return;
+    
+    std::vector<std::pair<std::size_t, const std::string*>> order;
+    for (const auto& entry : latest) {
+        order.emplace_back(entry.second.first, &entry.first);
+    }
+    std::sort(order.begin(), order.end());
+    if (order.size() > max_entries_) order.erase(order.begin(), order.end() - max_entries_);
+    
+    std::string compacted;
+    for (const auto& entry : order) {
+        compacted += Record(*entry.second, latest[*entry.second].second);
+    }
+    const std::string path = this->LogPath(tag);
+    std::ofstream out(path + ".tmp", std::ios::binary | std::ios::trunc);
+    out.write(compacted.data(), compacted.size());
+    out.close();
+    // A failed rewrite keeps the old log
+    if (!out || std::rename((path + ".tmp").c_str(), path.c_str()) != 0) std::remove((path + ".tmp").c_str());
+}
+
+std::optional<std::vector<double>> ResultCache::Get(const CacheKey& key, std::string_view tag) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key.Bytes());
+            if (it != entries_.end()) {
+                lru_.splice(lru_.begin(), lru_, it->second.position);
+                hits_++;
+                if (attempt == 1) disk_hits_++;
+                return it->second.values;
+            }
+        }
+        
+        if (directory_.empty()) break;
+        if (attempt == 0) this->Load(tag);
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    misses_++;
+    return std::nullopt;
+}
+
+void ResultCache::Put(const CacheKey& key, const std::vector<double>& values, std::string_view tag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    this->Insert(key.Bytes(), tag, values);
+    
+    if (!directory_.empty()) {
+        // One record in one append: other readers see it whole or not at all
+        const std::string record = Record(key.Bytes(), values);
+        
+        // A failed write only loses the disk copy
+        int fd = ::open(this->LogPath(tag).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            ssize_t written = ::write(fd, record.data(), record.size());
+            (void)written;
+            ::close(fd);
+        }
+        
+        // A long-running writer compacts as it goes, so the log stays within a few times max_entries records
+        if (++appended_[std::string(tag)] >= max_entries_) this->Compact(tag, this->ReadLog(tag));
+    }
+}
+
+std::vector<double> ResultCache::GetOrCompute(const CacheKey& key, const std::function<std::vector<double> ()>& compute, std::string_view tag) {
+    if (std::optional<std::vector<double>> hit = this->Get(key, tag)) return *hit;
+    
+    std::vector<double> values = compute();
+    this->Put(key, values, tag);
+    return values;
+}
+
+void ResultCache::Invalidate(std::string_view tag) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.tag == tag) {
+            lru_.erase(it->second.position);
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    if (!directory_.empty()) {
+        std::error_code error;
+        std::filesystem::remove(this->LogPath(tag), error);
+    }
+    // Nothing left to load
+    loaded_.insert(std::string(tag));
+    appended_.erase(std::string(tag));
+}
+
+void ResultCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    loaded_.clear();
+    appended_.clear();
+    
+    if (!directory_.empty()) {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory_, error)) {
+            if (entry.path().extension() == ".log") std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+std::size_t ResultCache::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::size_t ResultCache::Hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::size_t ResultCache::DiskHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return disk_hits_;
+}
+
+std::size_t ResultCache::Misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
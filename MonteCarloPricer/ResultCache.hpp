@@ -0,0 +1,98 @@
+//
+//  ResultCache.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ResultCache_hpp
+#define ResultCache_hpp
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class CacheKey {
+    // Exact identity of a deterministic computation: a method name (with a version, bumped whenever its results change)
+    // followed by every input in binary, so equal keys mean equal results and no two inputs collide
+private:
+    std::string bytes_;
+    
+public:
+    CacheKey(std::string_view method);
+    ~CacheKey() = default;
+    
+    CacheKey& Add(double x);
+    CacheKey& Add(std::uint64_t n);
+    CacheKey& Add(std::string_view s);  // Length-prefixed
+    
+    const std::string& Bytes() const { return bytes_; }
+    std::uint64_t Hash() const;
+    
+    // 64-bit FNV-1a
+    static std::uint64_t FNV1a(std::string_view bytes);
+};
+
+class ResultCache {
+    // Memoized results of deterministic pricing calls
+    // Memory: least recently used entries evicted beyond max_entries. Disk (optional): one append-only log per tag,
+    // directory/<tag hash>.log, one record per Put written with a single append; a memory miss reads the tag's log
+    // back into memory (later records win, a torn last record is ignored), so results are kept across runs.
+    // A log that is mostly superseded records is rewritten with its latest max_entries records when loaded, and every
+    // max_entries appends, so it stays bounded.
+    // Hits compare the whole key, so a hash collision is a miss, never a wrong result.
+    // Entries carry a tag (e.g. the underlying); Invalidate(tag) drops them from both tiers when its market inputs change.
+    // Thread-safe; one process should write a directory at a time.
+private:
+    struct Entry {
+        std::string tag;
+        std::vector<double> values;
+        std::list<std::string>::iterator position;
+    };
+    
+    struct Hasher {
+        std::size_t operator () (const std::string& bytes) const { return static_cast<std::size_t>(CacheKey::FNV1a(bytes)); }
+    };
+    
+    mutable std::mutex mutex_;
+    std::size_t max_entries_;
+    std::string directory_;             // Empty: memory only
+    std::list<std::string> lru_;        // Keys, most recent first
+    std::unordered_map<std::string, Entry, Hasher> entries_;
+    std::unordered_set<std::string> loaded_;    // Tags whose log is in memory (dropped when one of their entries is evicted)
+    std::unordered_map<std::string, std::size_t> appended_;   // Records appended per tag since its log was last compacted
+    std::size_t hits_;
+    std::size_t disk_hits_;
+    std::size_t misses_;
+    
+    std::string LogPath(std::string_view tag) const;
+    void Insert(const std::string& key, std::string_view tag, const std::vector<double>& values);
+    // Read a tag's log into memory, once
+    void Load(std::string_view tag);
+    std::string ReadLog(std::string_view tag) const;
+    // Rewrite a tag's log (its current contents) without superseded or excess records, if they are half of it
+    void Compact(std::string_view tag, const std::string& log);
+    
+public:
+    ResultCache(std::size_t max_entries = 1 << 16, const std::string& directory = "");
+    ~ResultCache() = default;
+    
+    std::optional<std::vector<double>> Get(const CacheKey& key, std::string_view tag = "");
+    void Put(const CacheKey& key, const std::vector<double>& values, std::string_view tag = "");
+    std::vector<double> GetOrCompute(const CacheKey& key, const std::function<std::vector<double> ()>& compute, std::string_view tag = "");
+    
+    void Invalidate(std::string_view tag);
+    void Clear();               // Both tiers
+    
+    std::size_t Size() const;   // In memory
+    std::size_t Hits() const;   // Memory and disk
+    std::size_t DiskHits() const;
+    std::size_t Misses() const;
+};
+
+#endif /* ResultCache_hpp */
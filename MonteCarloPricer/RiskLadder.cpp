@@ -0,0 +1,115 @@
+//
+//  RiskLadder.cpp
+//  MonteCarloPricer
+//
+
+#include "RiskLadder.hpp"
+#include "RNG.hpp"
+#include "ThreadPool.hpp"
+#include "VectorMath.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+RiskLadder::RiskLadder(const EuropeanOption& option, std::vector<std::shared_ptr<const PathDependentOption>> payoffs) : option_(option), payoffs_(std::move(payoffs)) {}
+
+std::vector<std::vector<std::vector<double>>> RiskLadder::Price(const std::vector<double>& spots, const std::vector<double>& vols, std::size_t path_length, std::size_t num_paths, unsigned long seed, unsigned num_threads, std::size_t block_size) const {
+    
+    // Reseed RNG machine
+    LCE_uniform::reseed(seed);
+    
+    if (num_threads == 0) num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    num_threads = std::min<unsigned>(num_threads, static_cast<unsigned>(vols.size()));
+    
+    // Started once for the whole run; blocks only submit to it
+    std::unique_ptr<ThreadPool> pool;
+    if (num_threads > 1) pool = std::make_unique<ThreadPool>(num_threads);
+    
+    const double dt = option_.T_ / path_length;
+    const double sqrt_dt = std::sqrt(dt);
+    const double carry = option_.r_ - option_.q_;
+    
+    // Nodes to keep: all of them, or only the last one when every payoff is terminal
+    const bool terminal_only = std::all_of(payoffs_.cbegin(), payoffs_.cend(), [](const std::shared_ptr<const PathDependentOption>& payoff) { return payoff->TerminalOnly(); });
+    std::vector<std::size_t> observed;
+    if (terminal_only) {
+        observed.push_back(path_length - 1);
+    } else {
+        observed.resize(path_length);
+        std::iota(observed.begin(), observed.end(), 0);
+    }
+    
+    std::vector<std::vector<std::vector<double>>> sum_V(payoffs_.size(), std::vector<std::vector<double>>(spots.size(), std::vector<double>(vols.size(), 0.)));
+    
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t block_paths = std::min(block_size, num_paths - done);
+        
+        // Brownian paths W at the observed nodes, time-major, shared by every grid point
+        // Normals come in pairs: an odd count draws one spare normal, which no path uses
+        const std::size_t size = block_paths * path_length;
+        std::vector<double> Z(StandardGaussianMatrix::gen(size + size % 2));
+        std::vector<double> W(observed.size() * block_paths);
+        std::vector<double> W_t(block_paths, 0.);
+        std::size_t t = 0;
+        for (std::size_t k = 0; k < observed.size(); k++) {
+            for (; t <= observed[k]; t++) {
+                const double* z_row = Z.data() + t * block_paths;
+                for (std::size_t p = 0; p < block_paths; p++) {
+                    W_t[p] += sqrt_dt * z_row[p];
+                }
+            }
+            std::copy(W_t.cbegin(), W_t.cend(), W.begin() + k * block_paths);
+        }
+        
+        // One vol column per task; each column is summed block by block in order, whichever thread runs it
+        auto RevalueColumn = [&](std::size_t j) {
+            OneAssetPathBlock unit(1., block_paths, observed.size());
+            OneAssetPathBlock block(1., block_paths, observed.size());
+            
+            // S_t / S0 for this volatility: one scale and shift of W, then one batched exp
+            const double sigma = vols[j];
+            for (std::size_t k = 0; k < observed.size(); k++) {
+                const double shift = (carry - sigma * sigma / 2.) * (observed[k] + 1) * dt;
+                const double* W_row = W.data() + k * block_paths;
+                double* row = unit.Step(k);
+                for (std::size_t p = 0; p < block_paths; p++) {
+                    row[p] = shift + sigma * W_row[p];
+                }
+            }
+            VectorMath::Exp(unit.S);
+            
+            // Each spot is a rescaling of the unit paths
+            for (std::size_t i = 0; i < spots.size(); i++) {
+                block.S0 = spots[i];
+                std::transform(unit.S.cbegin(), unit.S.cend(), block.S.begin(), [=](double s)->double { return spots[i] * s; });
+                for (std::size_t k = 0; k < payoffs_.size(); k++) {
+                    std::vector<double> V((*payoffs_[k])(block));
+                    sum_V[k][i][j] += std::accumulate(V.cbegin(), V.cend(), 0.);
+                }
+            }
+        };
+        
+        if (pool) {
+            for (std::size_t j = 0; j < vols.size(); j++) {
+                pool->Submit([&RevalueColumn, j] { RevalueColumn(j); });
+            }
+            pool->Wait();
+        } else {
+            for (std::size_t j = 0; j < vols.size(); j++) {
+                RevalueColumn(j);
+            }
+        }
+    }
+    
+    const double discount = std::exp(-option_.r_ * option_.T_);
+    for (std::vector<std::vector<double>>& grid : sum_V) {
+        for (std::vector<double>& row : grid) {
+            for (double& v : row) {
+                v *= discount / num_paths;
+            }
+        }
+    }
+    
+    return sum_V;
+}
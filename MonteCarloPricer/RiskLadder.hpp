@@ -0,0 +1,37 @@
+//
+//  RiskLadder.hpp
+//  MonteCarloPricer
+//
+
+#ifndef RiskLadder_hpp
+#define RiskLadder_hpp
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include "EuropeanOption.hpp"
+#include "PathDependentOption.hpp"
+
+class RiskLadder {
+    // Revalues a set of payoffs on a spot x vol grid from a single set of normals
+    // Under Black-Scholes every grid point is an analytic remap of the same Brownian paths:
+    // log S_t = log S0 + (r - q - sigma^2 / 2) t + sigma W_t
+    // so a vol column is one scale and shift of W (and one batched exp), and a spot row is one multiply per node
+private:
+    EuropeanOption option_;             // Base parameters (T, r, q)
+    std::vector<std::shared_ptr<const PathDependentOption>> payoffs_;
+    
+public:
+    // Every payoff is evaluated on each shared block of paths
+    RiskLadder(const EuropeanOption& option, std::vector<std::shared_ptr<const PathDependentOption>> payoffs);
+    // A single payoff, copied
+    template <class Payoff, std::enable_if_t<std::is_base_of_v<PathDependentOption, Payoff>, int> = 0>
+    RiskLadder(const EuropeanOption& option, const Payoff& payoff) : RiskLadder(option, {std::make_shared<const Payoff>(payoff)}) {}
+    ~RiskLadder() = default;
+    
+    // Discounted prices: res[k][i][j] of payoff k at spot spots[i] and volatility vols[j]
+    // Vol columns are spread over a pool of num_threads threads (0: hardware concurrency); results do not depend on it
+    std::vector<std::vector<std::vector<double>>> Price(const std::vector<double>& spots, const std::vector<double>& vols, std::size_t path_length, std::size_t num_paths, unsigned long seed = 1, unsigned num_threads = 0, std::size_t block_size = 8192) const;
+};
+
+#endif /* RiskLadder_hpp */
@@ -0,0 +1,174 @@
+//
+//  ScenarioStore.cpp
+//  MonteCarloPricer
+//
+
+#include "ScenarioStore.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "PathGenerator.hpp"
+#include "RNG.hpp"
+
+namespace {
+
+const char magic[8] = {'M', 'C', 'P', 'S', 'C', 'E', 'N', '\0'};
+const std::uint32_t version = 2;
+const std::uint32_t byte_order = 0x01020304;
+const std::size_t alignment = 64;
+
+static_assert(sizeof(ScenarioHeader) == 2 * alignment, "the header fills the first 128 bytes");
+
+std::size_t ValueBytes(ScenarioPrecision precision) {
+    return precision == Float32 ? sizeof(float) : sizeof(double);
+}
+
+std::size_t PaddedBlockBytes(const ScenarioHeader& header) {
+    const std::size_t bytes = header.block_size * header.path_length * ValueBytes(static_cast<ScenarioPrecision>(header.precision));
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+}
+
+ScenarioWriter::ScenarioWriter(const std::string& path, ScenarioKind kind, ScenarioPrecision precision, std::size_t num_paths, std::size_t path_length, std::size_t block_size, unsigned long seed, double S0, double T, double sigma, double r, double q) : path_(path), file_(path + ".tmp", std::ios::binary | std::ios::trunc), written_(0) {
+    assert(path_length > 0 && block_size > 0);
+    if (!file_) throw std::runtime_error("cannot write " + path + ".tmp");
+    
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, magic, sizeof(magic));
+    header_.version = version;
+    header_.byte_order = byte_order;
+    header_.kind = kind;
+    header_.precision = precision;
+    header_.num_paths = num_paths;
+    header_.path_length = path_length;
+    header_.block_size = block_size;
+    header_.seed = seed;
+    header_.S0 = S0;
+    header_.T = T;
+    header_.sigma = sigma;
+    header_.r = r;
+    header_.q = q;
+    
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+}
+
+ScenarioWriter::~ScenarioWriter() {
+    if (file_.is_open()) {
+        file_.close();
+        std::remove((path_ + ".tmp").c_str());
+    }
+}
+
+void ScenarioWriter::WriteBlock(const double* values, std::size_t block_paths) {
+    assert(block_paths == std::min<std::size_t>(header_.block_size, header_.num_paths - written_));
+    const std::size_t size = block_paths * header_.path_length;
+    
+    std::size_t bytes;
+    if (header_.precision == Float32) {
+        std::vector<float> narrow(values, values + size);
+        bytes = size * sizeof(float);
+        file_.write(reinterpret_cast<const char*>(narrow.data()), bytes);
+    } else {
+        bytes = size * sizeof(double);
+        file_.write(reinterpret_cast<const char*>(values), bytes);
+    }
+    
+    // Keep the next block aligned
+    const char zeros[alignment] = {};
+    file_.write(zeros, (alignment - bytes % alignment) % alignment);
+    written_ += block_paths;
+}
+
+void ScenarioWriter::Close() {
+    assert(written_ == header_.num_paths);
+    file_.close();
+    if (!file_ || std::rename((path_ + ".tmp").c_str(), path_.c_str()) != 0) {
+        std::remove((path_ + ".tmp").c_str());
+        throw std::runtime_error("cannot write " + path_);
+    }
+}
+
+void ScenarioWriter::WriteNormals(const std::string& path, unsigned long seed, std::size_t num_paths, std::size_t path_length, std::size_t block_size, ScenarioPrecision precision) {
+    ScenarioWriter writer(path, ScenarioNormals, precision, num_paths, path_length, block_size, seed);
+    
+    LCE_uniform::reseed(seed);
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t n = std::min(block_size, num_paths - done);
+        const std::size_t size = n * path_length;
+        writer.WriteBlock(StandardGaussianMatrix::gen(size + size % 2).data(), n);
+    }
+    writer.Close();
+}
+
+void ScenarioWriter::WritePaths(const std::string& path, double S0, double T, double sigma, double r, double q, unsigned long seed, std::size_t num_paths, std::size_t path_length, std::size_t block_size, ScenarioPrecision precision) {
+    ScenarioWriter writer(path, ScenarioPaths, precision, num_paths, path_length, block_size, seed, S0, T, sigma, r, q);
+    
+    LCE_uniform::reseed(seed);
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t n = std::min(block_size, num_paths - done);
+        const std::size_t size = n * path_length;
+        std::vector<double> Z(StandardGaussianMatrix::gen(size + size % 2));
+        OneAssetPathBlock_BS block(S0, T, sigma, r, q, n, path_length, Z.data());
+        writer.WriteBlock(block.S.data(), n);
+    }
+    writer.Close();
+}
+
+ScenarioStore::ScenarioStore(const std::string& path) : file_(path), header_(nullptr), block_bytes_(0) {
+    std::string_view data = file_.View();
+    if (data.size() < sizeof(ScenarioHeader)) throw std::runtime_error(path + ": not a scenario file");
+    
+    header_ = reinterpret_cast<const ScenarioHeader*>(data.data());
+    if (std::memcmp(header_->magic, magic, sizeof(magic)) != 0) throw std::runtime_error(path + ": not a scenario file");
+    if (header_->version != version) throw std::runtime_error(path + ": unsupported version " + std::to_string(header_->version));
+    if (header_->byte_order != byte_order) throw std::runtime_error(path + ": written with another byte order");
+    if (header_->kind > ScenarioPaths || header_->precision > Float32 || header_->path_length == 0 || header_->block_size == 0) throw std::runtime_error(path + ": bad header");
+    
+    block_bytes_ = PaddedBlockBytes(*header_);
+    if (this->NumBlocks() > 0) {
+        const std::size_t last = this->NumBlocks() - 1;
+        const std::size_t end = sizeof(ScenarioHeader) + last * block_bytes_ + this->BlockPaths(last) * header_->path_length * ValueBytes(this->Precision());
+        if (data.size() < end) throw std::runtime_error(path + ": truncated");
+    }
+}
+
+void ScenarioStore::CheckModel(double S0, double T, double sigma, double r, double q) const {
+    if (this->Kind() != ScenarioPaths) return;
+    
+    // The writer stored the caller's doubles, so equal inputs compare equal
+    if (header_->S0 != S0 || header_->T != T || header_->sigma != sigma || header_->r != r || header_->q != q) {
+        char message[256];
+        std::snprintf(message, sizeof(message), "scenario paths simulated with S0 %g, T %g, sigma %g, r %g, q %g, priced with S0 %g, T %g, sigma %g, r %g, q %g", header_->S0, header_->T, header_->sigma, header_->r, header_->q, S0, T, sigma, r, q);
+        throw std::runtime_error(message);
+    }
+}
+
+std::size_t ScenarioStore::NumBlocks() const {
+    return (header_->num_paths + header_->block_size - 1) / header_->block_size;
+}
+
+std::size_t ScenarioStore::BlockPaths(std::size_t block) const {
+    assert(block < this->NumBlocks());
+    return std::min<std::size_t>(header_->block_size, header_->num_paths - block * header_->block_size);
+}
+
+const double* ScenarioStore::Block(std::size_t block) const {
+    assert(this->Precision() == Float64 && block < this->NumBlocks());
+    return reinterpret_cast<const double*>(file_.View().data() + sizeof(ScenarioHeader) + block * block_bytes_);
+}
+
+const float* ScenarioStore::BlockFloat(std::size_t block) const {
+    assert(this->Precision() == Float32 && block < this->NumBlocks());
+    return reinterpret_cast<const float*>(file_.View().data() + sizeof(ScenarioHeader) + block * block_bytes_);
+}
+
+const double* ScenarioStore::Block(std::size_t block, std::vector<double>& buffer) const {
+    if (this->Precision() == Float64) return this->Block(block);
+    
+    const float* values = this->BlockFloat(block);
+    buffer.assign(values, values + this->BlockPaths(block) * header_->path_length);
+    return buffer.data();
+}
@@ -0,0 +1,107 @@
+//
+//  ScenarioStore.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ScenarioStore_hpp
+#define ScenarioStore_hpp
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+enum ScenarioKind {
+    ScenarioNormals,    // Standard normal increments
+    ScenarioPaths,      // Simulated prices (S0 and the model in the header)
+};
+
+enum ScenarioPrecision {
+    Float64,
+    Float32,
+};
+
+struct ScenarioHeader {
+    // File layout, version 2:
+    //  128-byte header (this struct, native byte order, checked through byte_order)
+    //  then the blocks of block_size paths (the last one may be short), each time-major,
+    //  value t of path p of a block at [t * block_paths + p], each block starting on a 64-byte boundary
+    char magic[8];              // "MCPSCEN\0"
+    std::uint32_t version;
+    std::uint32_t byte_order;   // 0x01020304 as written
+    std::uint32_t kind;         // ScenarioKind
+    std::uint32_t precision;    // ScenarioPrecision
+    std::uint64_t num_paths;
+    std::uint64_t path_length;
+    std::uint64_t block_size;
+    std::uint64_t seed;         // Provenance (0 if unknown)
+    double S0;                  // Paths only
+    double T;                   // Paths only: the model they were simulated under
+    double sigma;
+    double r;
+    double q;
+    char reserved[32];          // Zero
+};
+
+class ScenarioWriter {
+    // Writes a store block by block to path.tmp and renames it into place on Close,
+    // so readers never see a partial file
+private:
+    ScenarioHeader header_;
+    std::string path_;
+    std::ofstream file_;
+    std::uint64_t written_;     // Paths
+    
+public:
+    ScenarioWriter(const std::string& path, ScenarioKind kind, ScenarioPrecision precision, std::size_t num_paths, std::size_t path_length, std::size_t block_size, unsigned long seed = 0, double S0 = 0., double T = 0., double sigma = 0., double r = 0., double q = 0.);
+    ~ScenarioWriter();          // Discards an unclosed file
+    
+    // The next block, time-major, block_size paths (fewer for the last one)
+    void WriteBlock(const double* values, std::size_t block_paths);
+    void Close();
+    
+    // Normals exactly as TradePricer draws them: reseed, then one gen(size + size % 2) per block
+    static void WriteNormals(const std::string& path, unsigned long seed, std::size_t num_paths, std::size_t path_length, std::size_t block_size = 1 << 13, ScenarioPrecision precision = Float64);
+    // Black-Scholes paths simulated from those normals
+    static void WritePaths(const std::string& path, double S0, double T, double sigma, double r, double q, unsigned long seed, std::size_t num_paths, std::size_t path_length, std::size_t block_size = 1 << 13, ScenarioPrecision precision = Float64);
+};
+
+class ScenarioStore {
+    // Read-only view of a scenario file through mmap: float64 blocks are read in place, without a copy,
+    // and every process that opens the file shares its pages. Throws std::runtime_error on a malformed file.
+private:
+    MappedFile file_;
+    const ScenarioHeader* header_;
+    std::size_t block_bytes_;   // Of a full block, padded
+    
+public:
+    ScenarioStore(const std::string& path);
+    ~ScenarioStore() = default;
+    
+    ScenarioKind Kind() const { return static_cast<ScenarioKind>(header_->kind); }
+    ScenarioPrecision Precision() const { return static_cast<ScenarioPrecision>(header_->precision); }
+    std::size_t NumPaths() const { return header_->num_paths; }
+    std::size_t PathLength() const { return header_->path_length; }
+    std::size_t BlockSize() const { return header_->block_size; }
+    unsigned long Seed() const { return header_->seed; }
+    double S0() const { return header_->S0; }
+    double T() const { return header_->T; }
+    double Sigma() const { return header_->sigma; }
+    double R() const { return header_->r; }
+    double Q() const { return header_->q; }
+    
+    // Throws std::runtime_error if stored paths were simulated from another spot or model; normals fit any
+    void CheckModel(double S0, double T, double sigma, double r, double q) const;
+    
+    std::size_t NumBlocks() const;
+    std::size_t BlockPaths(std::size_t block) const;
+    
+    // Float64 stores only, in place
+    const double* Block(std::size_t block) const;
+    const float* BlockFloat(std::size_t block) const;     // Float32 stores only
+    // Either precision, widened into buffer if needed; valid until the next call with the same buffer
+    const double* Block(std::size_t block, std::vector<double>& buffer) const;
+};
+
+#endif /* ScenarioStore_hpp */
@@ -0,0 +1,95 @@
+//
+//  Serialization.cpp
+//  MonteCarloPricer
+//
+
+#include "Serialization.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+void ByteWriter::PutBytes(std::string_view bytes) {
+    bytes_.append(bytes);
+}
+
+void ByteWriter::PutUInt64(std::uint64_t n) {
+    bytes_.append(reinterpret_cast<const char*>(&n), sizeof(n));
+}
+
+void ByteWriter::PutDouble(double x) {
+    bytes_.append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+void ByteWriter::PutDoubles(const std::vector<double>& x) {
+    this->PutUInt64(x.size());
+    bytes_.append(reinterpret_cast<const char*>(x.data()), x.size() * sizeof(double));
+}
+
+void ByteWriter::PutString(std::string_view s) {
+    this->PutUInt64(s.size());
+    bytes_.append(s);
+}
+
+void ByteWriter::WriteFile(const std::string& path) const {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        file.write(bytes_.data(), bytes_.size());
+        file.close();
+        if (!file) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("cannot write " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+ByteReader::ByteReader(std::string_view data) : data_(data), pos_(0) {}
+
+std::string_view ByteReader::Take(std::size_t n) {
+    if (n > data_.size() - pos_) throw std::runtime_error("serialized data is truncated");
+    std::string_view res = data_.substr(pos_, n);
+    pos_ += n;
+    return res;
+}
+
+std::string_view ByteReader::GetBytes(std::size_t n) {
+    return this->Take(n);
+}
+
+std::uint64_t ByteReader::GetUInt64() {
+    std::uint64_t n;
+    std::memcpy(&n, this->Take(sizeof(n)).data(), sizeof(n));
+    return n;
+}
+
+double ByteReader::GetDouble() {
+    double x;
+    std::memcpy(&x, this->Take(sizeof(x)).data(), sizeof(x));
+    return x;
+}
+
+std::vector<double> ByteReader::GetDoubles() {
+    const std::uint64_t n = this->GetUInt64();
+    if (n > (data_.size() - pos_) / sizeof(double)) throw std::runtime_error("serialized data is truncated");
+    std::vector<double> x(n);
+    std::memcpy(x.data(), this->Take(n * sizeof(double)).data(), n * sizeof(double));
+    return x;
+}
+
+std::string_view ByteReader::GetString() {
+    return this->Take(this->GetUInt64());
+}
+
+std::string ByteReader::ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad()) throw std::runtime_error("cannot read " + path);
+    return data;
+}
@@ -0,0 +1,63 @@
+//
+//  Serialization.hpp
+//  MonteCarloPricer
+//
+
+#ifndef Serialization_hpp
+#define Serialization_hpp
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ByteWriter {
+    // Flat binary encoding of accumulator state: integers and doubles are copied bit for bit (native byte order),
+    // so a state read back continues exactly as the one written
+private:
+    std::string bytes_;
+    
+public:
+    ByteWriter() = default;
+    ~ByteWriter() = default;
+    
+    void PutBytes(std::string_view bytes);
+    void PutUInt64(std::uint64_t n);
+    void PutDouble(double x);
+    // Size first
+    void PutDoubles(const std::vector<double>& x);
+    void PutString(std::string_view s);
+    
+    const std::string& Bytes() const { return bytes_; }
+    
+    // Replaces the file at path atomically: written to path.tmp, then renamed over it,
+    // so a reader (or a job killed mid-write) sees the old contents or the new ones, never a mix
+    void WriteFile(const std::string& path) const;
+};
+
+class ByteReader {
+    // Reads what ByteWriter wrote, in the same order
+    // Throws std::runtime_error when the data ends early
+private:
+    std::string_view data_;
+    std::size_t pos_;
+    
+    std::string_view Take(std::size_t n);
+    
+public:
+    ByteReader(std::string_view data);
+    ~ByteReader() = default;
+    
+    std::string_view GetBytes(std::size_t n);
+    std::uint64_t GetUInt64();
+    double GetDouble();
+    std::vector<double> GetDoubles();
+    std::string_view GetString();
+    
+    bool AtEnd() const { return pos_ == data_.size(); }
+    
+    // Whole file; throws std::runtime_error if it cannot be read
+    static std::string ReadFile(const std::string& path);
+};
+
+#endif /* Serialization_hpp */
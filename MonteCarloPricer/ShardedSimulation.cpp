@@ -0,0 +1,233 @@
+//
+//  ShardedSimulation.cpp
+//  MonteCarloPricer
+//
+
+#include "ShardedSimulation.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <csignal>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "RNG.hpp"
+#include "ResultCache.hpp"
+#include "Serialization.hpp"
+
+namespace {
+
+const char magic[8] = {'M', 'C', 'P', 'S', 'H', '0', '0', '1'};
+
+}
+
+PartialResult::PartialResult(const std::vector<double>& control_means, double compression) : estimator(control_means), sketch(compression) {}
+
+void PartialResult::Add(const std::vector<std::vector<double>>& columns) {
+    const std::size_t k = columns.size() - 1;
+    std::vector<double> x(k);
+    for (std::size_t i = 0; i < columns[0].size(); i++) {
+        for (std::size_t c = 0; c < k; c++) {
+            x[c] = columns[c + 1][i];
+        }
+        estimator.Add(columns[0][i], x);
+    }
+    sketch.Add(columns[0].data(), columns[0].size());
+}
+
+void PartialResult::Merge(const PartialResult& other) {
+    estimator.Merge(other.estimator);
+    sketch.Merge(other.sketch);
+}
+
+void PartialResult::Save(ByteWriter& writer) const {
+    estimator.Save(writer);
+    sketch.Save(writer);
+}
+
+PartialResult PartialResult::Load(ByteReader& reader) {
+    ControlVariateEstimator estimator(ControlVariateEstimator::Load(reader));
+    QuantileSketch sketch(QuantileSketch::Load(reader));
+    PartialResult res(estimator.ControlMeans());
+    res.estimator = estimator;
+    res.sketch = sketch;
+    return res;
+}
+
+ShardedSimulation::ShardedSimulation(const Sampler& sampler, const std::vector<double>& control_means, std::size_t normals_per_path, std::size_t num_paths, std::size_t chunk_paths, unsigned long seed, double compression) : sampler_(sampler), control_means_(control_means), num_paths_(num_paths), chunk_paths_(chunk_paths), seed_(seed), compression_(compression), stride_(2ull * normals_per_path * chunk_paths + 256) {
+    assert(chunk_paths > 0 && normals_per_path > 0);
+    if (static_cast<double>(stride_) * this->NumChunks() > LCE_uniform::period()) throw std::runtime_error("ShardedSimulation: the chunks need more draws than the period of LCE_uniform");
+}
+
+std::uint64_t ShardedSimulation::Fingerprint() const {
+    CacheKey key("ShardedSimulation/1");
+    key.Add(static_cast<std::uint64_t>(num_paths_)).Add(static_cast<std::uint64_t>(chunk_paths_)).Add(static_cast<std::uint64_t>(seed_)).Add(static_cast<std::uint64_t>(stride_)).Add(compression_);
+    for (double mu : control_means_) {
+        key.Add(mu);
+    }
+    return key.Hash();
+}
+
+std::pair<std::size_t, std::size_t> ShardedSimulation::ShardChunks(std::size_t shard, std::size_t num_shards) const {
+    assert(shard < num_shards);
+    const std::size_t n = this->NumChunks();
+    return std::make_pair(n * shard / num_shards, n * (shard + 1) / num_shards);
+}
+
+PartialResult ShardedSimulation::RunChunk(std::size_t chunk) const {
+    const std::size_t n = std::min(chunk_paths_, num_paths_ - chunk * chunk_paths_);
+    LCE_uniform::reseed(LCE_uniform::skip(seed_, stride_ * chunk));
+    PartialResult res(control_means_, compression_);
+    const unsigned long long first_draw = LCE_uniform::draws();
+    res.Add(sampler_(n));
+    
+    // The polar method draws a random number of uniforms, so the stride is checked rather than assumed
+    if (LCE_uniform::draws() - first_draw > stride_) throw std::runtime_error("ShardedSimulation: chunk " + std::to_string(chunk) + " drew past its stride into the next chunk's stream");
+    return res;
+}
+
+std::string ShardedSimulation::RunShard(std::size_t first_chunk, std::size_t last_chunk) const {
+    assert(first_chunk <= last_chunk && last_chunk <= this->NumChunks());
+    ByteWriter writer;
+    writer.PutBytes(std::string_view(magic, sizeof(magic)));
+    writer.PutUInt64(this->Fingerprint());
+    writer.PutUInt64(first_chunk);
+    writer.PutUInt64(last_chunk);
+    for (std::size_t chunk = first_chunk; chunk < last_chunk; chunk++) {
+        this->RunChunk(chunk).Save(writer);
+    }
+    return writer.Bytes();
+}
+
+PartialResult ShardedSimulation::Merge(const std::vector<std::string>& shards) const {
+    // Every chunk's partial result, by chunk index
+    std::vector<std::vector<PartialResult>> by_shard;
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    for (const std::string& shard : shards) {
+        ByteReader reader(shard);
+        if (reader.GetBytes(sizeof(magic)) != std::string_view(magic, sizeof(magic))) throw std::runtime_error("ShardedSimulation: not a shard output");
+        if (reader.GetUInt64() != this->Fingerprint()) throw std::runtime_error("ShardedSimulation: shard output of another job");
+        const std::size_t first = reader.GetUInt64();
+        const std::size_t last = reader.GetUInt64();
+        if (first > last || last > this->NumChunks()) throw std::runtime_error("ShardedSimulation: bad chunk range");
+        
+        std::vector<PartialResult> partial;
+        for (std::size_t chunk = first; chunk < last; chunk++) {
+            partial.push_back(PartialResult::Load(reader));
+        }
+        if (!reader.AtEnd()) throw std::runtime_error("ShardedSimulation: trailing bytes in shard output");
+        by_shard.push_back(std::move(partial));
+        ranges.emplace_back(first, last);
+    }
+    
+    // Chunk order, whatever the order of the shards
+    std::vector<std::size_t> order(shards.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&ranges](std::size_t a, std::size_t b) { return ranges[a] < ranges[b]; });
+    
+    PartialResult res(control_means_, compression_);
+    std::size_t next = 0;
+    for (std::size_t i : order) {
+        if (ranges[i].first == ranges[i].second) continue;
+        if (ranges[i].first != next) throw std::runtime_error("ShardedSimulation: chunks " + std::to_string(next) + " onwards are missing or duplicated");
+        for (const PartialResult& partial : by_shard[i]) {
+            res.Merge(partial);
+        }
+        next = ranges[i].second;
+    }
+    if (next != this->NumChunks()) throw std::runtime_error("ShardedSimulation: chunks " + std::to_string(next) + " onwards are missing");
+    return res;
+}
+
+PartialResult ShardedSimulation::RunLocal(std::size_t num_workers) const {
+    assert(num_workers > 0);
+    std::vector<pid_t> workers;
+    std::vector<int> pipes;
+    
+    // A failed pipe or fork stops the workers already started and reaps them, so neither they nor their pipes leak
+    auto abandon = [&workers, &pipes](const char* message) {
+        for (int pipe : pipes) {
+            ::close(pipe);
+        }
+        for (pid_t pid : workers) {
+            ::kill(pid, SIGKILL);
+            while (::waitpid(pid, nullptr, 0) < 0 && errno == EINTR) {}
+        }
+        throw std::runtime_error(message);
+    };
+    
+    for (std::size_t w = 0; w < num_workers; w++) {
+        int fd[2];
+        if (::pipe(fd) != 0) abandon("ShardedSimulation: pipe failed");
+        const pid_t pid = ::fork();
+        if (pid < 0) {
+            ::close(fd[0]);
+            ::close(fd[1]);
+            abandon("ShardedSimulation: fork failed");
+        }
+        
+        if (pid == 0) {
+            // Worker: compute the shard, write it, and leave without running the parent's destructors
+            ::close(fd[0]);
+            for (int other : pipes) {
+                ::close(other);
+            }
+            int status = 0;
+            try {
+                const std::pair<std::size_t, std::size_t> range(this->ShardChunks(w, num_workers));
+                const std::string out = this->RunShard(range.first, range.second);
+                for (std::size_t done = 0; done < out.size(); ) {
+                    const ssize_t written = ::write(fd[1], out.data() + done, out.size() - done);
+                    if (written < 0 && errno == EINTR) continue;
+                    if (written <= 0) {
+                        status = 1;
+                        break;
+                    }
+                    done += written;
+                }
+            } catch (...) {
+                status = 1;
+            }
+            ::_exit(status);
+        }
+        
+        ::close(fd[1]);
+        workers.push_back(pid);
+        pipes.push_back(fd[0]);
+    }
+    
+    // The workers run concurrently; each only blocks on its pipe until its turn to be read
+    std::vector<std::string> shards(num_workers);
+    char buffer[1 << 16];
+    for (std::size_t w = 0; w < num_workers; w++) {
+        for (;;) {
+            const ssize_t n = ::read(pipes[w], buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            shards[w].append(buffer, n);
+        }
+        ::close(pipes[w]);
+    }
+    
+    bool failed = false;
+    for (pid_t pid : workers) {
+        int status = 0;
+        pid_t waited;
+        while ((waited = ::waitpid(pid, &status, 0)) < 0 && errno == EINTR) {}
+        failed = failed || waited != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    if (failed) throw std::runtime_error("ShardedSimulation: a worker failed");
+    
+    return this->Merge(shards);
+}
+
+PartialResult ShardedSimulation::RunInProcess() const {
+    // The same chunks in the same order, never serialized
+    PartialResult res(control_means_, compression_);
+    for (std::size_t chunk = 0; chunk < this->NumChunks(); chunk++) {
+        res.Merge(this->RunChunk(chunk));
+    }
+    return res;
+}
@@ -0,0 +1,96 @@
+//
+//  ShardedSimulation.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ShardedSimulation_hpp
+#define ShardedSimulation_hpp
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ControlVariateEstimator.hpp"
+#include "ConvergenceStudy.hpp"
+#include "QuantileSketch.hpp"
+
+class ByteWriter;
+class ByteReader;
+
+class PartialResult {
+    // Mergeable state of a range of samples: the control-variate co-moments of (Y, X_1, ..., X_k)
+    // and a t-digest of Y. Merges are exact for the moments (Chan et al.), centroid re-merges for the sketch.
+public:
+    ControlVariateEstimator estimator;
+    QuantileSketch sketch;
+    
+    PartialResult(const std::vector<double>& control_means, double compression = 1000.);
+    ~PartialResult() = default;
+    
+    // Sampler columns (Y, X_1, ..., X_k)
+    void Add(const std::vector<std::vector<double>>& columns);
+    void Merge(const PartialResult& other);
+    
+    void Save(ByteWriter& writer) const;
+    static PartialResult Load(ByteReader& reader);
+};
+
+class ShardedSimulation {
+    // One job of num_paths samples split over processes, on this host or others, with no shared state.
+    // The samples are cut into chunks of chunk_paths. Chunk c reseeds LCE_uniform stride * c draws after the seed
+    // (LCE_uniform::skip), where stride is two uniforms per normal of the chunk plus 256, so any process can simulate
+    // any chunk without drawing through the others.
+    // The polar method draws a random number of uniforms (4 / pi per normal on average), so a chunk counts its
+    // draws (LCE_uniform::draws) and throws std::runtime_error if it ran past its stride: chunk streams are disjoint
+    // or the job fails. The margin makes that vanishingly rare: about 0.87 sqrt(n) standard deviations for a chunk
+    // of n normals (27 at n = 1000), and the 256 spare draws cover small chunks.
+    // Capacity: the stride spends the period of LCE_uniform (2^31 - 2) at about two uniforms per normal, so one job is capped
+    // at about 1.07e9 normals (num_paths * normals_per_path) over all its chunks; the constructor throws beyond that.
+    // A shard is a contiguous range of chunks and returns one serialized PartialResult per chunk; Merge then
+    // folds all chunks in chunk order. The result is therefore the same bits for any number of shards and
+    // any assignment of shards to processes, and equals RunInProcess().
+    // The sampler draws n samples from the current LCE_uniform state, as for ConvergenceStudy; it is not
+    // recorded in the shard output, so every process must be given the same one.
+public:
+    using Sampler = ConvergenceStudy::Sampler;
+    
+private:
+    Sampler sampler_;
+    std::vector<double> control_means_;
+    std::size_t num_paths_;
+    std::size_t chunk_paths_;
+    unsigned long seed_;
+    double compression_;
+    unsigned long long stride_;     // Uniform draws reserved per chunk
+    
+    // Identity of the job (everything but the sampler), checked when merging
+    std::uint64_t Fingerprint() const;
+    PartialResult RunChunk(std::size_t chunk) const;
+    
+public:
+    // normals_per_path: normals one sample draws (the path length, for path-dependent payoffs)
+    // Throws std::runtime_error if the chunks need more draws than the period of LCE_uniform (see the cap above).
+    ShardedSimulation(const Sampler& sampler, const std::vector<double>& control_means, std::size_t normals_per_path, std::size_t num_paths, std::size_t chunk_paths = 1 << 14, unsigned long seed = 1, double compression = 1000.);
+    ~ShardedSimulation() = default;
+    
+    std::size_t NumChunks() const { return (num_paths_ + chunk_paths_ - 1) / chunk_paths_; }
+    // Chunks [first, last) of shard i out of num_shards, as even as the chunks allow
+    std::pair<std::size_t, std::size_t> ShardChunks(std::size_t shard, std::size_t num_shards) const;
+    
+    // What a worker computes and sends back: chunks [first_chunk, last_chunk), serialized
+    std::string RunShard(std::size_t first_chunk, std::size_t last_chunk) const;
+    // Coordinator: shard outputs in any order; throws std::runtime_error unless they belong to this job
+    // and cover every chunk exactly once
+    PartialResult Merge(const std::vector<std::string>& shards) const;
+    
+    // Forks num_workers processes, one shard each, and merges what they write back through pipes
+    // Throws std::runtime_error if a worker fails
+    // The workers are forked without exec and allocate, so the caller must have no other threads running
+    // (a lock held by another thread at the fork stays held in the worker). A threaded caller should instead
+    // start worker processes with fork + exec (or on other hosts) that call RunShard, and Merge their output.
+    PartialResult RunLocal(std::size_t num_workers) const;
+    // All chunks in this process
+    PartialResult RunInProcess() const;
+};
+
+#endif /* ShardedSimulation_hpp */
@@ -0,0 +1,99 @@
+//
+//  SimulationCache.cpp
+//  MonteCarloPricer
+//
+
+#include "SimulationCache.hpp"
+#include <algorithm>
+#include "RNG.hpp"
+#include "TradeFile.hpp"
+
+namespace {
+
+// Distinct schedules kept before the table is cleared
+const std::size_t max_schedules = 4096;
+
+}
+
+SimulationCache::SimulationCache(std::size_t capacity_bytes) : capacity_bytes_(capacity_bytes), size_bytes_(0), hits_(0), misses_(0) {}
+
+std::shared_ptr<const std::vector<double>> SimulationCache::Normals(unsigned long seed, std::size_t num_paths, std::size_t path_length, std::size_t block_size) {
+    const NormalKey key(seed, num_paths, path_length, block_size);
+    
+    // Block sizes padded to whole pairs
+    std::size_t total = 0;
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t size = std::min(block_size, num_paths - done) * path_length;
+        total += size + size % 2;
+    }
+    const std::size_t bytes = total * sizeof(double);
+    if (bytes > capacity_bytes_ / 4) return nullptr;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = normals_.find(key);
+        if (it != normals_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.position);
+            hits_++;
+            return it->second.normals;
+        }
+        misses_++;
+    }
+    
+    // Drawn outside the lock; a concurrent miss on the same key keeps the first copy
+    auto normals = std::make_shared<std::vector<double>>();
+    normals->reserve(total);
+    LCE_uniform::reseed(seed);
+    for (std::size_t done = 0; done < num_paths; done += block_size) {
+        const std::size_t size = std::min(block_size, num_paths - done) * path_length;
+        std::vector<double> Z = StandardGaussianMatrix::gen(size + size % 2);
+        normals->insert(normals->end(), Z.cbegin(), Z.cend());
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = normals_.find(key);
+    if (it != normals_.end()) return it->second.normals;
+    
+    while (size_bytes_ + bytes > capacity_bytes_ && !lru_.empty()) {
+        auto victim = normals_.find(lru_.back());
+        size_bytes_ -= victim->second.normals->size() * sizeof(double);
+        normals_.erase(victim);
+        lru_.pop_back();
+    }
+    lru_.push_front(key);
+    normals_[key] = NormalEntry({normals, lru_.begin()});
+    size_bytes_ += bytes;
+    
+    return normals;
+}
+
+std::shared_ptr<const DividendSchedule> SimulationCache::Schedule(double T, double sigma, double r, double q, std::string_view dividends) {
+    ScheduleKey key(T, sigma, r, q, std::string(dividends));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = schedules_.find(key);
+        if (it != schedules_.end()) return it->second;
+    }
+    
+    std::pair<Dividend, Dividend> parsed = TradeFile::ParseDividends(dividends, T);
+    auto schedule = std::make_shared<const DividendSchedule>(T, sigma, r, q, parsed.first, parsed.second);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (schedules_.size() >= max_schedules) schedules_.clear();
+    return schedules_.emplace(std::move(key), schedule).first->second;
+}
+
+std::size_t SimulationCache::Hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+std::size_t SimulationCache::Misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+std::size_t SimulationCache::SizeBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_bytes_;
+}
@@ -0,0 +1,58 @@
+//
+//  SimulationCache.hpp
+//  MonteCarloPricer
+//
+
+#ifndef SimulationCache_hpp
+#define SimulationCache_hpp
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "PathGenerator.hpp"
+
+class SimulationCache {
+    // Tables kept warm between pricing calls and shared by all threads:
+    //  the normals of a (seed, num_paths, path_length, block_size) simulation, least recently used evicted past a byte budget
+    //  compiled dividend schedules
+    // Normals are drawn exactly as TradePricer draws them (reseed, then one gen(size + size % 2) per block of paths),
+    // so a cached simulation prices identically to a fresh one.
+private:
+    using NormalKey = std::tuple<unsigned long, std::size_t, std::size_t, std::size_t>;
+    using ScheduleKey = std::tuple<double, double, double, double, std::string>;
+    
+    struct NormalEntry {
+        std::shared_ptr<const std::vector<double>> normals;
+        std::list<NormalKey>::iterator position;
+    };
+    
+    mutable std::mutex mutex_;
+    std::size_t capacity_bytes_;
+    std::size_t size_bytes_;
+    std::list<NormalKey> lru_;          // Most recent first
+    std::map<NormalKey, NormalEntry> normals_;
+    std::map<ScheduleKey, std::shared_ptr<const DividendSchedule>> schedules_;
+    std::size_t hits_;
+    std::size_t misses_;
+    
+public:
+    SimulationCache(std::size_t capacity_bytes = std::size_t(1) << 28);
+    ~SimulationCache() = default;
+    
+    // All blocks of normals back to back; null if the simulation exceeds a quarter of the budget (drawn on the fly instead)
+    // Reseeds the calling thread's generator on a miss
+    std::shared_ptr<const std::vector<double>> Normals(unsigned long seed, std::size_t num_paths, std::size_t path_length, std::size_t block_size);
+    // Throws std::runtime_error on a malformed schedule (see TradeFile::ParseDividends)
+    std::shared_ptr<const DividendSchedule> Schedule(double T, double sigma, double r, double q, std::string_view dividends);
+    
+    std::size_t Hits() const;
+    std::size_t Misses() const;
+    std::size_t SizeBytes() const;
+};
+
+#endif /* SimulationCache_hpp */
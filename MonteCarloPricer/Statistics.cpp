@@ -0,0 +1,59 @@
+//
+//  Statistics.cpp
+//  MonteCarloPricer
+//
+
+#include "Statistics.hpp"
+#include <cmath>
+#include "Serialization.hpp"
+
+RunningStatistics::RunningStatistics() : count_(0), mean_(0.), m2_(0.) {}
+
+void RunningStatistics::Add(double x) {
+    count_++;
+    const double delta = x - mean_;
+    mean_ += delta / count_;
+    m2_ += delta * (x - mean_);
+}
+
+void RunningStatistics::Add(const double* x, std::size_t n) {
+    for (std::size_t i = 0; i < n; i++) {
+        this->Add(x[i]);
+    }
+}
+
+void RunningStatistics::Merge(const RunningStatistics& other) {
+    if (other.count_ == 0) return;
+    
+    const std::size_t count = count_ + other.count_;
+    const double delta = other.mean_ - mean_;
+    mean_ += delta * other.count_ / count;
+    m2_ += other.m2_ + delta * delta * count_ * other.count_ / count;
+    count_ = count;
+}
+
+void RunningStatistics::Save(ByteWriter& writer) const {
+    writer.PutUInt64(count_);
+    writer.PutDouble(mean_);
+    writer.PutDouble(m2_);
+}
+
+RunningStatistics RunningStatistics::Load(ByteReader& reader) {
+    RunningStatistics res;
+    res.count_ = reader.GetUInt64();
+    res.mean_ = reader.GetDouble();
+    res.m2_ = reader.GetDouble();
+    return res;
+}
+
+double RunningStatistics::Variance() const {
+    return (count_ > 1) ? m2_ / (count_ - 1) : 0.;
+}
+
+double RunningStatistics::StdDev() const {
+    return std::sqrt(this->Variance());
+}
+
+double RunningStatistics::StdError() const {
+    return (count_ > 0) ? std::sqrt(this->Variance() / count_) : 0.;
+}
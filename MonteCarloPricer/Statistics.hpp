@@ -0,0 +1,42 @@
+//
+//  Statistics.hpp
+//  MonteCarloPricer
+//
+
+#ifndef Statistics_hpp
+#define Statistics_hpp
+
+#include <cstddef>
+
+class ByteWriter;
+class ByteReader;
+
+class RunningStatistics {
+    // Streaming mean and variance (Welford), free of the cancellation in sum-of-squares formulas
+    // Partial statistics merge exactly (Chan et al.)
+private:
+    std::size_t count_;
+    double mean_;
+    double m2_;     // sum (x - mean)^2
+    
+public:
+    RunningStatistics();
+    ~RunningStatistics() = default;
+    
+    void Add(double x);
+    void Add(const double* x, std::size_t n);
+    
+    void Merge(const RunningStatistics& other);
+    
+    // Exact state, for checkpoints and partial results
+    void Save(ByteWriter& writer) const;
+    static RunningStatistics Load(ByteReader& reader);
+    
+    std::size_t Count() const { return count_; }
+    double Mean() const { return mean_; }
+    double Variance() const;    // Sample variance (n - 1)
+    double StdDev() const;
+    double StdError() const;    // Of the mean
+};
+
+#endif /* Statistics_hpp */
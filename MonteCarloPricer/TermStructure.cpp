@@ -0,0 +1,105 @@
+//
+//  TermStructure.cpp
+//  MonteCarloPricer
+//
+
+#include "TermStructure.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+PiecewiseCurve::PiecewiseCurve(double flat) : PiecewiseCurve(std::vector<double>(), std::vector<double>({flat})) {}
+
+PiecewiseCurve::PiecewiseCurve(const std::vector<double>& times, const std::vector<double>& values) : times_(times), values_(values), cumulative_(times.size()) {
+    assert(!values_.empty());
+    
+    // One more value than knots: the last one applies beyond the last knot
+    if (values_.size() == times_.size()) {
+        values_.push_back(values_.back());
+    }
+    assert(values_.size() == times_.size() + 1);
+    assert(std::is_sorted(times_.cbegin(), times_.cend()));
+    
+    double prev_time = 0.;
+    double integral = 0.;
+    for (std::size_t i = 0; i < times_.size(); i++) {
+        integral += values_[i] * (times_[i] - prev_time);
+        cumulative_[i] = integral;
+        prev_time = times_[i];
+    }
+}
+
+double PiecewiseCurve::operator () (double t) const {
+    std::size_t i = std::lower_bound(times_.cbegin(), times_.cend(), t) - times_.cbegin();
+    return values_[i];
+}
+
+double PiecewiseCurve::Integral(double t) const {
+    std::size_t i = std::lower_bound(times_.cbegin(), times_.cend(), t) - times_.cbegin();
+    double knot_time = (i == 0) ? 0. : times_[i - 1];
+    double knot_integral = (i == 0) ? 0. : cumulative_[i - 1];
+    return knot_integral + values_[i] * (t - knot_time);
+}
+
+double PiecewiseCurve::Integral(double t0, double t1) const {
+    return this->Integral(t1) - this->Integral(t0);
+}
+
+PiecewiseCurve PiecewiseCurve::Squared() const {
+    std::vector<double> squared(values_.size());
+    std::transform(values_.cbegin(), values_.cend(), squared.begin(), [](double v)->double { return v * v; });
+    return PiecewiseCurve(times_, squared);
+}
+
+TermStructure::TermStructure(const PiecewiseCurve& r, const PiecewiseCurve& q, const PiecewiseCurve& sigma) : r_(r), q_(q), variance_(sigma.Squared()) {}
+
+double TermStructure::Discount(double t0, double t1) const {
+    return std::exp(-r_.Integral(t0, t1));
+}
+
+double TermStructure::Forward(double t0, double t1) const {
+    return std::exp(r_.Integral(t0, t1) - q_.Integral(t0, t1));
+}
+
+double TermStructure::Variance(double t0, double t1) const {
+    return variance_.Integral(t0, t1);
+}
+
+// Over an empty interval (t0 == t1) the averages are the values at t1, their limit from the left
+
+double TermStructure::AverageRate(double t0, double t1) const {
+    if (t1 == t0) return r_(t1);
+    return r_.Integral(t0, t1) / (t1 - t0);
+}
+
+double TermStructure::AverageYield(double t0, double t1) const {
+    if (t1 == t0) return q_(t1);
+    return q_.Integral(t0, t1) / (t1 - t0);
+}
+
+double TermStructure::AverageVol(double t0, double t1) const {
+    if (t1 == t0) return std::sqrt(variance_(t1));
+    return std::sqrt(variance_.Integral(t0, t1) / (t1 - t0));
+}
+
+TimeGridIntegrals TermStructure::OnGrid(const std::vector<double>& times) const {
+    TimeGridIntegrals grid;
+    grid.times = times;
+    
+    for (std::size_t i = 0; i + 1 < times.size(); i++) {
+        double variance = variance_.Integral(times[i], times[i + 1]);
+        grid.drift.push_back(r_.Integral(times[i], times[i + 1]) - q_.Integral(times[i], times[i + 1]) - variance / 2.);
+        grid.vol.push_back(std::sqrt(variance));
+    }
+    grid.discount = this->Discount(times.front(), times.back());
+    
+    return grid;
+}
+
+TimeGridIntegrals TermStructure::OnGrid(double T, std::size_t path_length) const {
+    std::vector<double> times(path_length + 1);
+    for (std::size_t i = 0; i <= path_length; i++) {
+        times[i] = T * i / path_length;
+    }
+    return this->OnGrid(times);
+}
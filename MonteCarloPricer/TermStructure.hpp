@@ -0,0 +1,75 @@
+//
+//  TermStructure.hpp
+//  MonteCarloPricer
+//
+
+#ifndef TermStructure_hpp
+#define TermStructure_hpp
+
+#include <vector>
+
+class PiecewiseCurve {
+    // Piecewise-constant curve: values[i] on (times[i - 1], times[i]], the last value extended flat
+    // The integral is cached at the knots, so Integral() is one search and one multiply-add
+private:
+    std::vector<double> times_;
+    std::vector<double> values_;
+    std::vector<double> cumulative_;    // Integral from 0 to times_[i]
+    
+public:
+    PiecewiseCurve(double flat);
+    // values: one per knot, or one more for beyond the last knot; at least one
+    PiecewiseCurve(const std::vector<double>& times, const std::vector<double>& values);
+    ~PiecewiseCurve() = default;
+    
+    double operator () (double t) const;
+    
+    // Integral from 0 to t
+    double Integral(double t) const;
+    // Integral from t0 to t1
+    double Integral(double t0, double t1) const;
+    
+    // Curve of the squared values (e.g. variance from volatility)
+    PiecewiseCurve Squared() const;
+};
+
+struct TimeGridIntegrals {
+    // Integrated quantities of a TermStructure on a fixed time grid, computed once and reused by every path
+    std::vector<double> times;      // t_0 < t_1 < ... < t_n
+    std::vector<double> drift;      // int (r - q) - var / 2 over (t_i, t_{i+1}]
+    std::vector<double> vol;        // sqrt(int sigma^2) over (t_i, t_{i+1}]
+    double discount;                // exp(-int r) over [t_0, t_n]
+    
+    std::size_t Steps() const { return drift.size(); }
+};
+
+class TermStructure {
+    // Piecewise rates, dividend yield and volatility
+private:
+    PiecewiseCurve r_;
+    PiecewiseCurve q_;
+    PiecewiseCurve variance_;
+    
+public:
+    TermStructure(const PiecewiseCurve& r, const PiecewiseCurve& q, const PiecewiseCurve& sigma);
+    ~TermStructure() = default;
+    
+    // Discount factor exp(-int r)
+    double Discount(double t0, double t1) const;
+    // Forward factor exp(int (r - q))
+    double Forward(double t0, double t1) const;
+    // Integrated variance int sigma^2
+    double Variance(double t0, double t1) const;
+    
+    // Flat equivalents over [t0, t1]: with these a constant-parameter model has the same terminal distribution
+    // (t0 == t1: the values at t1)
+    double AverageRate(double t0, double t1) const;
+    double AverageYield(double t0, double t1) const;
+    double AverageVol(double t0, double t1) const;
+    
+    TimeGridIntegrals OnGrid(const std::vector<double>& times) const;
+    // Uniform grid of path_length steps on [0, T]
+    TimeGridIntegrals OnGrid(double T, std::size_t path_length) const;
+};
+
+#endif /* TermStructure_hpp */
@@ -0,0 +1,104 @@
+//
+//  ThreadPool.cpp
+//  MonteCarloPricer
+//
+
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace {
+
+// Pool and deque of the calling worker thread, if any
+thread_local const void* current_pool = nullptr;
+thread_local std::size_t current_index = 0;
+
+}
+
+ThreadPool::ThreadPool(unsigned num_threads) : queued_(0), pending_(0), next_queue_(0), stop_(false) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    for (unsigned i = 0; i < num_threads; i++) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < num_threads; i++) {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    this->Wait();
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stop_ = true;
+    }
+    work_available_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void ()> task) {
+    const std::size_t index = (current_pool == this) ? current_index : next_queue_.fetch_add(1) % queues_.size();
+    
+    // Counted under the idle mutex before the push, so a worker about to sleep cannot miss the task
+    // (a worker woken early retries until the push lands)
+    pending_++;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        queued_++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    work_available_.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    all_done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+bool ThreadPool::TryRun(std::size_t index) {
+    std::function<void ()> task;
+    
+    // Own deque from the back, then the others from the front
+    const std::size_t n = queues_.size();
+    for (std::size_t k = 0; k < n && !task; k++) {
+        Queue& queue = *queues_[(index + k) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (k == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    
+    queued_--;
+    task();
+    
+    if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        all_done_.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::WorkerLoop(std::size_t index) {
+    current_pool = this;
+    current_index = index;
+    
+    while (true) {
+        if (this->TryRun(index)) continue;
+        
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        work_available_.wait(lock, [this] { return stop_ || queued_ > 0; });
+        if (stop_ && queued_ == 0) return;
+    }
+}
@@ -0,0 +1,59 @@
+//
+//  ThreadPool.hpp
+//  MonteCarloPricer
+//
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+    // Work-stealing pool: every worker owns a deque, runs its newest task first and, when it runs dry,
+    // steals the oldest task of another worker. Tasks submitted from outside are dealt round-robin;
+    // tasks submitted by a worker go to its own deque.
+    // Tasks run on arbitrary workers, so they must reseed any thread-local generator they use, and must not throw.
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void ()>> tasks;
+    };
+    
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    
+    std::atomic<std::size_t> queued_;       // In a deque
+    std::atomic<std::size_t> pending_;      // Submitted and not finished
+    std::atomic<std::size_t> next_queue_;
+    bool stop_;
+    
+    std::mutex idle_mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    
+    bool TryRun(std::size_t index);
+    void WorkerLoop(std::size_t index);
+    
+public:
+    ThreadPool(unsigned num_threads = 0);   // 0: hardware concurrency
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+    ~ThreadPool();                          // Finishes the queued tasks
+    
+    unsigned NumThreads() const { return static_cast<unsigned>(workers_.size()); }
+    // Tasks submitted and not finished
+    std::size_t Pending() const { return pending_; }
+    
+    void Submit(std::function<void ()> task);
+    // Block until every submitted task has finished
+    void Wait();
+};
+
+#endif /* ThreadPool_hpp */
@@ -0,0 +1,279 @@
+//
+//  TradeFile.cpp
+//  MonteCarloPricer
+//
+
+#include "TradeFile.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+enum TradeField {
+    FieldId,
+    FieldUnderlying,
+    FieldType,
+    FieldOption,
+    FieldS,
+    FieldK,
+    FieldT,
+    FieldSigma,
+    FieldR,
+    FieldQ,
+    FieldBarrier,
+    FieldBarrierType,
+    FieldPathLength,
+    FieldNumPaths,
+    FieldSeed,
+    FieldDividends,
+    FieldUnknown,
+};
+
+TradeField FindField(std::string_view key) {
+    static const std::pair<std::string_view, TradeField> fields[] = {
+        {"id", FieldId}, {"underlying", FieldUnderlying}, {"type", FieldType}, {"option", FieldOption},
+        {"S", FieldS}, {"K", FieldK}, {"T", FieldT}, {"sigma", FieldSigma}, {"r", FieldR}, {"q", FieldQ},
+        {"barrier", FieldBarrier}, {"barrier_type", FieldBarrierType}, {"path_length", FieldPathLength},
+        {"num_paths", FieldNumPaths}, {"seed", FieldSeed}, {"dividends", FieldDividends},
+    };
+    for (const auto& field : fields) {
+        if (field.first == key) return field.second;
+    }
+    return FieldUnknown;
+}
+
+[[noreturn]] void Fail(std::size_t line, const std::string& message) {
+    throw std::runtime_error("line " + std::to_string(line) + ": " + message);
+}
+
+std::string_view Trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+double ParseDouble(std::string_view s, std::size_t line) {
+    double x = 0.;
+#if defined(__cpp_lib_to_chars)
+    auto res = std::from_chars(s.data(), s.data() + s.size(), x);
+    if (res.ec != std::errc() || res.ptr != s.data() + s.size()) Fail(line, "bad number '" + std::string(s) + "'");
+#else
+    // Floating-point from_chars is missing from older standard libraries
+    char buffer[64];
+    if (s.empty() || s.size() >= sizeof(buffer)) Fail(line, "bad number '" + std::string(s) + "'");
+    std::memcpy(buffer, s.data(), s.size());
+    buffer[s.size()] = '\0';
+    char* end;
+    x = std::strtod(buffer, &end);
+    if (end != buffer + s.size()) Fail(line, "bad number '" + std::string(s) + "'");
+#endif
+    return x;
+}
+
+unsigned long ParseUnsigned(std::string_view s, std::size_t line) {
+    unsigned long x = 0;
+    auto res = std::from_chars(s.data(), s.data() + s.size(), x);
+    if (res.ec != std::errc() || res.ptr != s.data() + s.size()) Fail(line, "bad integer '" + std::string(s) + "'");
+    return x;
+}
+
+void SetField(Trade& trade, TradeField field, std::string_view value, std::size_t line) {
+    switch (field) {
+        case FieldId: trade.id = value; break;
+        case FieldUnderlying: trade.underlying = value; break;
+        case FieldType:
+            if (value == "vanilla") trade.type = VanillaTrade;
+            else if (value == "barrier") trade.type = BarrierTrade;
+            else if (value == "asian") trade.type = AsianTrade;
+            else Fail(line, "unknown type '" + std::string(value) + "'");
+            break;
+        case FieldOption:
+            if (value == "call") trade.option_type = Call;
+            else if (value == "put") trade.option_type = Put;
+            else Fail(line, "unknown option '" + std::string(value) + "'");
+            break;
+        case FieldS: trade.S = ParseDouble(value, line); break;
+        case FieldK: trade.K = ParseDouble(value, line); break;
+        case FieldT: trade.T = ParseDouble(value, line); break;
+        case FieldSigma: trade.sigma = ParseDouble(value, line); break;
+        case FieldR: trade.r = ParseDouble(value, line); break;
+        case FieldQ: trade.q = ParseDouble(value, line); break;
+        case FieldBarrier: trade.B = ParseDouble(value, line); break;
+        case FieldBarrierType:
+            if (value == "up_in") trade.barrier_type = UpAndIn;
+            else if (value == "up_out") trade.barrier_type = UpAndOut;
+            else if (value == "down_in") trade.barrier_type = DownAndIn;
+            else if (value == "down_out") trade.barrier_type = DownAndOut;
+            else Fail(line, "unknown barrier_type '" + std::string(value) + "'");
+            break;
+        case FieldPathLength: trade.path_length = ParseUnsigned(value, line); break;
+        case FieldNumPaths: trade.num_paths = ParseUnsigned(value, line); break;
+        case FieldSeed: trade.seed = ParseUnsigned(value, line); break;
+        case FieldDividends: trade.dividends = value; break;
+        case FieldUnknown: break;
+    }
+}
+
+void Validate(const Trade& trade, std::size_t line) {
+    if (trade.id.empty()) Fail(line, "missing id");
+    if (!(trade.S > 0.) || !(trade.K > 0.) || !(trade.T > 0.) || !(trade.sigma > 0.)) Fail(line, "S, K, T and sigma must be positive");
+    if (trade.path_length == 0 || trade.num_paths == 0) Fail(line, "path_length and num_paths must be positive");
+    // The multiplicative generator is stuck at 0 and cycles modulo 2^31 - 1
+    if (trade.seed == 0 || trade.seed >= 2147483647ul) Fail(line, "seed must be in [1, 2^31 - 2]");
+}
+
+// Next line of text, without its terminator
+std::string_view NextLine(std::string_view& text) {
+    std::size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+}
+
+TradeFile::TradeFile(const std::string& path) : file_(path) {
+    std::string_view text = file_.View();
+    
+    const bool is_json = (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) || (path.size() >= 6 && path.compare(path.size() - 6, 6, ".jsonl") == 0) || Trim(text.substr(0, text.find('\n'))).substr(0, 1) == "{";
+    
+    if (is_json) {
+        this->ParseJSONLines(text);
+    } else {
+        this->ParseCSV(text);
+    }
+}
+
+void TradeFile::ParseCSV(std::string_view text) {
+    // Columns resolved once from the header
+    std::vector<TradeField> columns;
+    std::string_view header = NextLine(text);
+    while (!header.empty()) {
+        std::size_t comma = header.find(',');
+        columns.push_back(FindField(Trim(header.substr(0, comma))));
+        header.remove_prefix(comma == std::string_view::npos ? header.size() : comma + 1);
+    }
+    
+    // About one trade per 100 bytes
+    trades_.reserve(text.size() / 100 + 1);
+    
+    std::size_t line_number = 1;
+    while (!text.empty()) {
+        std::string_view line = Trim(NextLine(text));
+        line_number++;
+        if (line.empty() || line.front() == '#') continue;
+        
+        Trade trade;
+        std::size_t column = 0;
+        while (true) {
+            std::size_t comma = line.find(',');
+            std::string_view value = Trim(line.substr(0, comma));
+            if (column < columns.size() && !value.empty()) SetField(trade, columns[column], value, line_number);
+            column++;
+            if (comma == std::string_view::npos) break;
+            line.remove_prefix(comma + 1);
+        }
+        
+        Validate(trade, line_number);
+        trades_.push_back(trade);
+    }
+}
+
+void TradeFile::ParseJSONLines(std::string_view text) {
+    trades_.reserve(text.size() / 200 + 1);
+    
+    std::size_t line_number = 0;
+    while (!text.empty()) {
+        std::string_view line = Trim(NextLine(text));
+        line_number++;
+        if (line.empty()) continue;
+        
+        trades_.push_back(TradeFile::ParseJSONLine(line, line_number));
+    }
+}
+
+std::vector<std::pair<std::string_view, std::string_view>> TradeFile::ParseJSONObject(std::string_view line, std::size_t line_number) {
+    line = Trim(line);
+    
+    // One flat object: string keys, string or number values
+    if (line.empty() || line.front() != '{' || line.back() != '}') Fail(line_number, "expected a JSON object");
+    line = line.substr(1, line.size() - 2);
+    
+    std::vector<std::pair<std::string_view, std::string_view>> fields;
+    while (true) {
+        line = Trim(line);
+        if (line.empty()) break;
+        
+        if (line.front() != '"') Fail(line_number, "expected a key");
+        std::size_t key_end = line.find('"', 1);
+        if (key_end == std::string_view::npos) Fail(line_number, "unterminated key");
+        std::string_view key = line.substr(1, key_end - 1);
+        line = Trim(line.substr(key_end + 1));
+        if (line.empty() || line.front() != ':') Fail(line_number, "expected ':'");
+        line = Trim(line.substr(1));
+        
+        std::string_view value;
+        if (!line.empty() && line.front() == '"') {
+            // Strings are taken verbatim: no escapes
+            std::size_t value_end = line.find('"', 1);
+            if (value_end == std::string_view::npos) Fail(line_number, "unterminated string");
+            value = line.substr(1, value_end - 1);
+            if (value.find('\\') != std::string_view::npos) Fail(line_number, "escapes are not supported");
+            line = Trim(line.substr(value_end + 1));
+        } else {
+            std::size_t value_end = line.find(',');
+            value = Trim(line.substr(0, value_end));
+            line = line.substr(value_end == std::string_view::npos ? line.size() : value_end);
+        }
+        
+        if (value != "null") fields.emplace_back(key, value);
+        
+        if (line.empty()) break;
+        if (line.front() != ',') Fail(line_number, "expected ','");
+        line.remove_prefix(1);
+    }
+    
+    return fields;
+}
+
+Trade TradeFile::ParseJSONLine(std::string_view line, std::size_t line_number) {
+    Trade trade;
+    for (const auto& field : TradeFile::ParseJSONObject(line, line_number)) {
+        SetField(trade, FindField(field.first), field.second, line_number);
+    }
+    
+    Validate(trade, line_number);
+    return trade;
+}
+
+std::pair<Dividend, Dividend> TradeFile::ParseDividends(std::string_view dividends, double T) {
+    Dividend proportional;
+    Dividend fixed;
+    
+    while (!dividends.empty()) {
+        std::size_t end = dividends.find(';');
+        std::string_view event = Trim(dividends.substr(0, end));
+        dividends.remove_prefix(end == std::string_view::npos ? dividends.size() : end + 1);
+        if (event.empty()) continue;
+        
+        // kind:t:value
+        std::size_t first = event.find(':');
+        std::size_t second = event.find(':', first + 1);
+        std::string_view kind = event.substr(0, first);
+        if (second == std::string_view::npos || (kind != "p" && kind != "f")) throw std::runtime_error("bad dividend '" + std::string(event) + "'");
+        
+        Dividend& target = (kind == "p") ? proportional : fixed;
+        const double t = ParseDouble(event.substr(first + 1, second - first - 1), 0);
+        // The schedule merges the two kinds in order and simulates up to T from the last date
+        if (!(t > 0.) || !(t < T)) throw std::runtime_error("dividend date outside (0, T) '" + std::string(event) + "'");
+        if (!target.dates.empty() && t < target.dates.back()) throw std::runtime_error("dividend dates not sorted '" + std::string(event) + "'");
+        target.dates.push_back(t);
+        target.dividends.push_back(ParseDouble(event.substr(second + 1), 0));
+    }
+    
+    return std::make_pair(proportional, fixed);
+}
@@ -0,0 +1,78 @@
+//
+//  TradeFile.hpp
+//  MonteCarloPricer
+//
+
+#ifndef TradeFile_hpp
+#define TradeFile_hpp
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "EuropeanOption.hpp"
+#include "MappedFile.hpp"
+#include "PathDependentOption.hpp"
+
+enum TradeType {
+    VanillaTrade,
+    BarrierTrade,
+    AsianTrade,
+};
+
+struct Trade {
+    // Strings are views into the trade file, which must outlive the trades
+    std::string_view id;
+    std::string_view underlying;
+    TradeType type = VanillaTrade;
+    EuropeanOptionType option_type = Call;
+    
+    double S = 0.;
+    double K = 0.;
+    double T = 0.;
+    double sigma = 0.;
+    double r = 0.;
+    double q = 0.;
+    
+    double B = 0.;                      // Barrier trades
+    BarrierType barrier_type = DownAndOut;
+    
+    std::size_t path_length = 1;
+    std::size_t num_paths = 10000;
+    unsigned long seed = 1;
+    
+    // Discrete dividends (vanilla trades): events "p:t:value" (proportional) or "f:t:value" (fixed), separated by ';'
+    std::string_view dividends;
+};
+
+class TradeFile {
+    // Trades parsed in place from a memory-mapped file, in one of two formats:
+    //  CSV: a header line naming the columns, then one trade per line (no quoted fields)
+    //  JSON lines: one flat object per line, e.g. {"id": "t1", "underlying": "ABC", "type": "barrier", ...}
+    // Keys/columns: id, underlying, type (vanilla, barrier, asian), option (call, put), S, K, T, sigma, r, q,
+    // barrier, barrier_type (up_in, up_out, down_in, down_out), path_length, num_paths, seed, dividends.
+    // Unknown keys are ignored; malformed lines throw std::runtime_error with the line number.
+private:
+    MappedFile file_;
+    std::vector<Trade> trades_;
+    
+    void ParseCSV(std::string_view text);
+    void ParseJSONLines(std::string_view text);
+    
+public:
+    // Format from the extension (.jsonl, .json) or the first character ('{')
+    TradeFile(const std::string& path);
+    ~TradeFile() = default;
+    
+    const std::vector<Trade>& Trades() const { return trades_; }
+    
+    // One JSON object; the trade views the line
+    static Trade ParseJSONLine(std::string_view line, std::size_t line_number = 1);
+    // Key-value pairs of one flat JSON object (null values left out), viewing the line
+    static std::vector<std::pair<std::string_view, std::string_view>> ParseJSONObject(std::string_view line, std::size_t line_number = 1);
+    
+    // Proportional and fixed dividends of a trade with maturity T; throws std::runtime_error
+    // unless each kind's dates are sorted and inside (0, T)
+    static std::pair<Dividend, Dividend> ParseDividends(std::string_view dividends, double T);
+};
+
+#endif /* TradeFile_hpp */
@@ -0,0 +1,243 @@
+//
+//  TradePricer.cpp
+//  MonteCarloPricer
+//
+
+#include "TradePricer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <variant>
+#include "PathGenerator.hpp"
+#include "RNG.hpp"
+#include "ResultCache.hpp"
+#include "SimulationCache.hpp"
+#include "Statistics.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+// Everything that determines the paths of a trade
+auto SimulationKey(const Trade& trade) {
+    return std::tie(trade.underlying, trade.S, trade.sigma, trade.r, trade.q, trade.T, trade.path_length, trade.num_paths, trade.seed, trade.dividends);
+}
+
+// Every input of a trade's price (not its id)
+CacheKey ResultKey(const Trade& trade, std::size_t block_size) {
+    CacheKey key("TradePricer::PriceGroup/2");
+    key.Add(std::uint64_t(trade.type)).Add(std::uint64_t(trade.option_type));
+    key.Add(trade.S).Add(trade.K).Add(trade.T).Add(trade.sigma).Add(trade.r).Add(trade.q);
+    key.Add(trade.B).Add(std::uint64_t(trade.barrier_type));
+    key.Add(std::uint64_t(trade.path_length)).Add(std::uint64_t(trade.num_paths)).Add(std::uint64_t(trade.seed));
+    key.Add(trade.dividends).Add(std::uint64_t(block_size));
+    return key;
+}
+
+using Payoff = std::variant<VanillaOption, BarrierOption, AsianOption>;
+
+Payoff MakePayoff(const Trade& trade) {
+    EuropeanOption option(0., trade.S, trade.K, trade.T, trade.sigma, trade.r, trade.q);
+    switch (trade.type) {
+        case BarrierTrade:
+            return BarrierOption(option, trade.B, trade.option_type, trade.barrier_type);
+        case AsianTrade:
+            if (trade.option_type == Put) throw std::runtime_error("Asian puts are not supported");
+            return AsianOption(option, trade.option_type);
+        case VanillaTrade:
+        default:
+            return VanillaOption(option, trade.option_type);
+    }
+}
+
+}
+
+TradePricer::TradePricer(std::size_t block_size, SimulationCache* cache, ResultCache* results) : block_size_(block_size), cache_(cache), results_(results) {
+    // A zero block never advances the path loops
+    if (block_size_ == 0) throw std::invalid_argument("TradePricer: block_size must be positive");
+}
+
+std::vector<std::vector<std::size_t>> TradePricer::Group(const std::vector<Trade>& trades) {
+    // Sort by key, then every run of equal keys is a group
+    std::vector<std::size_t> order(trades.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&trades](std::size_t a, std::size_t b) {
+        return SimulationKey(trades[a]) < SimulationKey(trades[b]);
+    });
+    
+    std::vector<std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < order.size(); i++) {
+        if (i == 0 || SimulationKey(trades[order[i]]) != SimulationKey(trades[order[i - 1]])) {
+            groups.emplace_back();
+        }
+        groups.back().push_back(order[i]);
+    }
+    
+    // Largest simulations first, so the tail of the schedule is short
+    auto cost = [&trades](const std::vector<std::size_t>& group) {
+        const Trade& trade = trades[group.front()];
+        return static_cast<double>(trade.num_paths) * static_cast<double>(trade.path_length) * (1. + 0.1 * group.size());
+    };
+    std::stable_sort(groups.begin(), groups.end(), [&cost](const std::vector<std::size_t>& a, const std::vector<std::size_t>& b) {
+        return cost(a) > cost(b);
+    });
+    
+    return groups;
+}
+
+std::vector<TradeResult> TradePricer::PriceGroup(const std::vector<Trade>& trades, const std::vector<std::size_t>& group) const {
+    // Runs as a pool task, which must not throw: a failure of the whole group is reported on each of its trades
+    std::string error;
+    try {
+        return this->SimulateGroup(trades, group);
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "unknown error";
+    }
+    
+    std::vector<TradeResult> res(group.size());
+    for (std::size_t g = 0; g < group.size(); g++) {
+        res[g].index = group[g];
+        res[g].error = error;
+    }
+    return res;
+}
+
+std::vector<TradeResult> TradePricer::SimulateGroup(const std::vector<Trade>& trades, const std::vector<std::size_t>& group) const {
+    const Trade& first = trades[group.front()];
+    const std::size_t num_paths = first.num_paths;
+    const double discount = std::exp(-first.r * first.T);
+    
+    std::vector<TradeResult> res(group.size());
+    std::vector<RunningStatistics> stats(group.size());
+    
+    // Payoffs of the group; trades that fail here are reported and skipped
+    std::vector<Payoff> payoffs;
+    std::vector<std::size_t> priced;    // Positions in the group
+    bool terminal_only = true;
+    for (std::size_t g = 0; g < group.size(); g++) {
+        const Trade& trade = trades[group[g]];
+        res[g].index = group[g];
+        try {
+            if (!trade.dividends.empty() && trade.type != VanillaTrade) {
+                throw std::runtime_error("dividends are only supported for vanilla trades");
+            }
+            payoffs.push_back(MakePayoff(trade));
+            priced.push_back(g);
+            terminal_only = terminal_only && (trade.type == VanillaTrade);
+        } catch (const std::exception& e) {
+            res[g].error = e.what();
+        }
+    }
+    if (priced.empty()) return res;
+    
+    std::vector<bool> hit(group.size(), false);
+    if (results_) {
+        bool all_hit = true;
+        for (std::size_t g : priced) {
+            const Trade& trade = trades[group[g]];
+            if (std::optional<std::vector<double>> values = results_->Get(ResultKey(trade, block_size_), trade.underlying)) {
+                res[g].value = (*values)[0];
+                res[g].std_error = (*values)[1];
+                hit[g] = true;
+            } else {
+                all_hit = false;
+            }
+        }
+        if (all_hit) return res;
+    }
+    
+    LCE_uniform::reseed(first.seed);
+    
+    if (!first.dividends.empty()) {
+        // Vanilla trades on a dividend schedule: one node per interval between dividends
+        std::shared_ptr<const DividendSchedule> schedule;
+        try {
+            if (cache_) {
+                schedule = cache_->Schedule(first.T, first.sigma, first.r, first.q, first.dividends);
+            } else {
+                std::pair<Dividend, Dividend> dividends = TradeFile::ParseDividends(first.dividends, first.T);
+                schedule = std::make_shared<const DividendSchedule>(first.T, first.sigma, first.r, first.q, dividends.first, dividends.second);
+            }
+        } catch (const std::exception& e) {
+            for (std::size_t g : priced) res[g].error = e.what();
+            return res;
+        }
+        
+        for (std::size_t done = 0; done < num_paths; done += block_size_) {
+            const std::size_t n = std::min(block_size_, num_paths - done);
+            OneAssetWithPath_BS paths(first.S, StandardGaussianMatrix::gen(n, schedule->Intervals()), *schedule);
+            
+            for (std::size_t k = 0; k < priced.size(); k++) {
+                const Trade& trade = trades[group[priced[k]]];
+                // gen may return one extra path when n and the interval count are both odd
+                for (std::size_t p = 0; p < n; p++) {
+                    const double S_T = paths.S[p].back();
+                    stats[priced[k]].Add(discount * std::max(0., trade.option_type == Call ? S_T - trade.K : trade.K - S_T));
+                }
+            }
+        }
+    } else {
+        // Vanilla-only groups keep just the last node
+        const std::size_t path_length = first.path_length;
+        std::vector<std::size_t> observed;
+        if (terminal_only) observed.push_back(path_length - 1);
+        
+        std::shared_ptr<const std::vector<double>> cached;
+        if (cache_) cached = cache_->Normals(first.seed, num_paths, path_length, block_size_);
+        
+        std::vector<double> Z;
+        std::size_t offset = 0;
+        for (std::size_t done = 0; done < num_paths; done += block_size_) {
+            const std::size_t n = std::min(block_size_, num_paths - done);
+            // Normals come in pairs
+            const std::size_t size = n * path_length;
+            const double* z;
+            if (cached) {
+                z = cached->data() + offset;
+            } else {
+                Z = StandardGaussianMatrix::gen(size + size % 2);
+                z = Z.data();
+            }
+            offset += size + size % 2;
+            OneAssetPathBlock_BS block(first.S, first.T, first.sigma, first.r, first.q, n, path_length, z, observed);
+            
+            for (std::size_t k = 0; k < priced.size(); k++) {
+                std::vector<double> V = std::visit([&block](const auto& payoff) { return payoff(block); }, payoffs[k]);
+                for (double& v : V) {
+                    v *= discount;
+                }
+                stats[priced[k]].Add(V.data(), V.size());
+            }
+        }
+    }
+    
+    for (std::size_t g : priced) {
+        res[g].value = stats[g].Mean();
+        res[g].std_error = stats[g].StdError();
+        if (results_ && !hit[g]) {
+            const Trade& trade = trades[group[g]];
+            results_->Put(ResultKey(trade, block_size_), {res[g].value, res[g].std_error}, trade.underlying);
+        }
+    }
+    return res;
+}
+
+void TradePricer::PriceAll(const std::vector<Trade>& trades, ThreadPool& pool, const std::function<void (const std::vector<TradeResult>&)>& on_group) const {
+    std::mutex output_mutex;
+    
+    for (const std::vector<std::size_t>& group : TradePricer::Group(trades)) {
+        pool.Submit([this, &trades, &on_group, &output_mutex, group] {
+            std::vector<TradeResult> res = this->PriceGroup(trades, group);
+            std::lock_guard<std::mutex> lock(output_mutex);
+            on_group(res);
+        });
+    }
+    
+    pool.Wait();
+}
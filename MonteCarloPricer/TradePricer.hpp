@@ -0,0 +1,62 @@
+//
+//  TradePricer.hpp
+//  MonteCarloPricer
+//
+
+#ifndef TradePricer_hpp
+#define TradePricer_hpp
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "TradeFile.hpp"
+
+class ThreadPool;
+class SimulationCache;
+class ResultCache;
+
+struct TradeResult {
+    std::size_t index;          // Into the trade list
+    double value;               // Discounted price
+    double std_error;
+    std::string error;          // Non-empty if the trade could not be priced
+    
+    void Print() const {
+        std::cout << index << '\t' << value << '\t' << std_error << '\t' << error << std::endl;
+    }
+};
+
+class TradePricer {
+    // Prices a trade list grouped by simulation: trades on the same underlying with the same model parameters,
+    // time grid, path count, seed and dividend schedule see the same paths, so each group simulates once
+    // and evaluates every payoff on the shared blocks.
+    // Barrier and Asian payoffs read all path_length nodes; vanilla payoffs read the last one.
+    // A group reseeds the generator with its seed, so results do not depend on the thread or the grouping order.
+    // With a cache, normals and dividend schedules are reused across calls (same results, see SimulationCache).
+    // With a result cache, trades seen before are answered from it (tagged with their underlying);
+    // a group is simulated only if one of its trades misses.
+private:
+    std::size_t block_size_;    // Paths per simulated block
+    SimulationCache* cache_;    // Optional, not owned
+    ResultCache* results_;      // Optional, not owned
+    
+    // PriceGroup without the catch
+    std::vector<TradeResult> SimulateGroup(const std::vector<Trade>& trades, const std::vector<std::size_t>& group) const;
+    
+public:
+    // Throws std::invalid_argument if block_size is 0
+    TradePricer(std::size_t block_size = 1 << 13, SimulationCache* cache = nullptr, ResultCache* results = nullptr);
+    ~TradePricer() = default;
+    
+    // Indices of the trades sharing a simulation, most expensive group first
+    static std::vector<std::vector<std::size_t>> Group(const std::vector<Trade>& trades);
+    
+    // One result per trade of the group, in group order; never throws (failures go to the trades' error fields)
+    std::vector<TradeResult> PriceGroup(const std::vector<Trade>& trades, const std::vector<std::size_t>& group) const;
+    
+    // Every group as one pool task; on_group is called from the workers, one group at a time
+    void PriceAll(const std::vector<Trade>& trades, ThreadPool& pool, const std::function<void (const std::vector<TradeResult>&)>& on_group) const;
+};
+
+#endif /* TradePricer_hpp */
@@ -0,0 +1,106 @@
+//
+//  VectorMath.cpp
+//  MonteCarloPricer
+//
+
+#include "VectorMath.hpp"
+#include <bit>
+#include <cstdint>
+
+// Configured with MCP_SIMD=DISPATCH: the loop is compiled once per instruction set and the best clone is picked at load time
+#if defined(MCP_SIMD_DISPATCH)
+#define MCP_SIMD_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define MCP_SIMD_CLONES
+#endif
+
+MCP_SIMD_CLONES void VectorMath::Exp(const double* in, double* out, std::size_t size) {
+    // exp(x) = 2^k * exp(s), k = round(x / ln2), |s| <= ln2 / 2
+    constexpr double log2e = 1.4426950408889634;
+    constexpr double ln2_hi = 6.93147180369123816490e-01;
+    constexpr double ln2_lo = 1.90821492927058770002e-10;
+    // Adding 1.5 * 2^52 rounds to an integer that sits in the low mantissa bits
+    constexpr double shift = 6755399441055744.;
+    
+    for (std::size_t i = 0; i < size; i++) {
+        double x = in[i];
+        // Past the limits the result is already 0 or inf
+        x = (x < -746.) ? -746. : x;
+        x = (x > 710.) ? 710. : x;
+        
+        double kd = x * log2e + shift;
+        std::uint64_t ki = std::bit_cast<std::uint64_t>(kd);
+        kd -= shift;
+        
+        double s = (x - kd * ln2_hi) - kd * ln2_lo;
+        
+        // Taylor polynomial of exp(s) to degree 12 (truncation error below 2e-16)
+        double p = 1. / 479001600.;
+        p = p * s + 1. / 39916800.;
+        p = p * s + 1. / 3628800.;
+        p = p * s + 1. / 362880.;
+        p = p * s + 1. / 40320.;
+        p = p * s + 1. / 5040.;
+        p = p * s + 1. / 720.;
+        p = p * s + 1. / 120.;
+        p = p * s + 1. / 24.;
+        p = p * s + 1. / 6.;
+        p = p * s + .5;
+        p = p * s + 1.;
+        p = p * s + 1.;
+        
+        // 2^k from the low bits of ki, as 2^floor(k/2) * 2^ceil(k/2): both halves stay normal for k in [-1076, 1024].
+        // The first product is exact, so the second rounds once, to a subnormal, 0 or inf as exp(x) does.
+        const std::uint64_t e = ki - std::bit_cast<std::uint64_t>(shift) + 2 * 1023;    // k + 2 * bias
+        const std::uint64_t e_lo = e >> 1;
+        double scale_lo = std::bit_cast<double>(e_lo << 52);
+        double scale_hi = std::bit_cast<double>((e - e_lo) << 52);
+        out[i] = (p * scale_lo) * scale_hi;
+    }
+}
+
+void VectorMath::Exp(std::vector<double>& x) {
+    VectorMath::Exp(x.data(), x.data(), x.size());
+}
+
+MCP_SIMD_CLONES void VectorMath::Exp(const float* in, float* out, std::size_t size) {
+    // Same reduction as above with float constants: 2^k * exp(s), |s| <= ln2 / 2
+    constexpr float log2e = 1.44269504f;
+    constexpr float ln2_hi = .693359375f;
+    constexpr float ln2_lo = -2.12194440e-4f;
+    // 1.5 * 2^23
+    constexpr float shift = 12582912.f;
+    
+    for (std::size_t i = 0; i < size; i++) {
+        float x = in[i];
+        x = (x < -104.f) ? -104.f : x;
+        x = (x > 89.f) ? 89.f : x;
+        
+        float kd = x * log2e + shift;
+        std::uint32_t ki = std::bit_cast<std::uint32_t>(kd);
+        kd -= shift;
+        
+        float s = (x - kd * ln2_hi) - kd * ln2_lo;
+        
+        // Taylor polynomial of exp(s) to degree 7 (truncation error below 1e-8)
+        float p = 1.f / 5040.f;
+        p = p * s + 1.f / 720.f;
+        p = p * s + 1.f / 120.f;
+        p = p * s + 1.f / 24.f;
+        p = p * s + 1.f / 6.f;
+        p = p * s + .5f;
+        p = p * s + 1.f;
+        p = p * s + 1.f;
+        
+        // Halves of 2^k stay normal for k in [-150, 128]
+        const std::uint32_t e = ki - std::bit_cast<std::uint32_t>(shift) + 2 * 127;
+        const std::uint32_t e_lo = e >> 1;
+        float scale_lo = std::bit_cast<float>(e_lo << 23);
+        float scale_hi = std::bit_cast<float>((e - e_lo) << 23);
+        out[i] = (p * scale_lo) * scale_hi;
+    }
+}
+
+void VectorMath::Exp(std::vector<float>& x) {
+    VectorMath::Exp(x.data(), x.data(), x.size());
+}
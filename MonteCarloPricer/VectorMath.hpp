@@ -0,0 +1,29 @@
+//
+//  VectorMath.hpp
+//  MonteCarloPricer
+//
+
+#ifndef VectorMath_hpp
+#define VectorMath_hpp
+
+#include <vector>
+
+class VectorMath {
+    // Batched elementary functions
+    // Written without branches so that the loops auto-vectorize
+public:
+    // No instances of VectorMath is needed.
+    VectorMath() = delete;
+    ~VectorMath() = default;
+    
+    // out[i] = exp(in[i]), accurate to about 1 ulp where the result is normal. in and out may alias.
+    // Like std::exp, it overflows to inf above 709.78 and goes subnormal below -708.4, down to 0 below -745.13.
+    static void Exp(const double* in, double* out, std::size_t size);
+    static void Exp(std::vector<double>& x);
+    // Single precision, accurate to about 1 ulp of float where the result is normal
+    // (inf above 88.72, subnormal below -87.34, 0 below -103.97); twice the lanes per vector
+    static void Exp(const float* in, float* out, std::size_t size);
+    static void Exp(std::vector<float>& x);
+};
+
+#endif /* VectorMath_hpp */
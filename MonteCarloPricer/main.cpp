@@ -5,11 +5,20 @@
 //  Created by 王明森 on 11/23/22.
 //
 
+#include <cstring>
 #include <iostream>
 #include "EuropeanOptionAnalyzer.hpp"
 #include "RNG.hpp"
 #include "PathDependentOption.hpp"
 #include "BarrierOptionAnalyzer.hpp"
+#include "ReplicationHarness.hpp"
+#include "ConvergenceStudy.hpp"
+#include "GreeksEngine.hpp"
+#include "RiskLadder.hpp"
+#include "MixedPrecision.hpp"
+#include "ShardedSimulation.hpp"
+#include "MultiAssetOption.hpp"
+#include "Statistics.hpp"
 #include <iomanip>
 #include <vector>
 
@@ -48,11 +57,15 @@ void TestDividend() {
     
     auto payoff = std::bind(option.PutPayoff(), std::placeholders::_1, 7. / 12.);
     
+    // Compile the schedule once for the whole sweep
+    DividendSchedule schedule(option.T_, option.sigma_, option.r_, option.q_, proportional, fixed);
+    
     EuropeanOptionAnalyzer analyzer(option);
+    
+    // One sample extended from 10,000 to 2,560,000, with the no-dividend put as control
+    ConvergenceStudy study([&](std::size_t n) { return analyzer.DiscountedPayoffs(n, payoff, schedule); }, {option.Put()});
     for (std::size_t n = 1; n <= 256; n <<= 1) {
-        LCE_uniform::reseed(1);
-        auto res = analyzer.Price(n * 10000, payoff, proportional, fixed);
-        std::cout << res[0] << '\t' << res[1] << '\t' << res[2] << '\t' << res[3] << '\t' << res[4] << std::endl;
+        study.ExtendTo(n * 10000).Print();
     }
 }
 
@@ -66,8 +79,10 @@ void TestBarrier() {
     
     double BS_price = barrier_option.BSPrice();
     
+    // One set of paths, extended at each doubling
+    ConvergenceStudy study([&](std::size_t n) { return analyzer.DiscountedPayoffs(200, n); });
     for (std::size_t n = 50; n < 51200; n <<= 1) {
-        double MC_price = analyzer.Price(200, n, 1);
+        double MC_price = study.ExtendTo(n).estimate.value;
         std::cout << MC_price << '\t' << std::abs(MC_price - BS_price) << std::endl;
     }
     
@@ -80,6 +95,79 @@ void TestBarrier() {
     
 }
 
+// Mean discounted payoff of the first N terminal prices of the normal stream from seed
+double FirstPathsMean(const EuropeanOption& option, const EuropeanOptionType& option_type, std::size_t N, unsigned long seed) {
+    LCE_uniform::reseed(seed);
+    std::vector<double> z(StandardGaussianMatrix::gen(N + N % 2));
+    const double sign = (option_type == Call) ? 1. : -1.;
+    double sum = 0.;
+    for (std::size_t p = 0; p < N; p++) {
+        double S_T = option.S_ * std::exp((option.r_ - option.q_ - option.sigma_ * option.sigma_ / 2.) * option.T_ + option.sigma_ * std::sqrt(option.T_) * z[p]);
+        sum += std::max(sign * (S_T - option.K_), 0.);
+    }
+    return sum / N * std::exp(-option.r_ * option.T_);
+}
+
+// Odd path counts: the spare normal of the last pair must not become a path
+bool TestOddPaths() {
+    EuropeanOption option(0., 41., 42., .75, .25, .03, .01);
+    GreeksEngine engine(option, Put);
+    bool ok = true;
+    for (std::size_t N : {1, 3, 1001, 8193}) {
+        double expected = FirstPathsMean(option, Put, N, 3);
+        double revalued = engine.Revalue({{0., 0., 0.}}, 1, N, 3, 8192)[0];
+        double ladder = RiskLadder(option, VanillaOption(option, Put)).Price({option.S_}, {option.sigma_}, 1, N, 3, 1, 8192)[0][0][0];
+        std::cout << N << '\t' << revalued << '\t' << ladder << '\t' << expected << std::endl;
+        ok = ok && std::abs(revalued - expected) <= 1e-12 * expected && std::abs(ladder - expected) <= 1e-12 * expected;
+    }
+    return ok;
+}
+
+void TestPrecision() {
+    EuropeanOption option(0., 42., 40., 7. / 12., .25, .03, .015);
+    BarrierOption barrier_option(option, 35., Call, DownAndOut);
+    
+    // mode, value, std error, difference to float64, in std errors, seconds, kernel seconds
+    for (const PrecisionEstimate& row : MixedPrecision::Validate(barrier_option, 200, 1000000)) {
+        row.Print();
+    }
+}
+
+// The same job in this process and over 4 worker processes: the same bits
+bool TestShards() {
+    EuropeanOption option(0., 42., 40., 7. / 12., .25, .03, .015);
+    BarrierOption barrier_option(option, 35., Call, DownAndOut);
+    BarrierOptionAnalyzer analyzer(barrier_option);
+    
+    ShardedSimulation simulation([&](std::size_t n) { return std::vector<std::vector<double>>({analyzer.DiscountedPayoffs(200, n)}); }, {}, 200, 1 << 20);
+    ControlVariateResults in_process = simulation.RunInProcess().estimator.Estimate();
+    ControlVariateResults sharded = simulation.RunLocal(4).estimator.Estimate();
+    in_process.Print();
+    sharded.Print();
+    return in_process.value == sharded.value && in_process.std_error == sharded.std_error;
+}
+
+// Two-asset exchange option against Margrabe's formula, within 3 standard errors
+bool TestMargrabe() {
+    const std::vector<double> S0({100., 95.}), sigma({.3, .2}), q({.02, .04});
+    const double T = 1., r = .03, rho = .5;
+    const std::size_t N = 200000;
+    SpreadOption exchange(0, 1, 0., Call);
+    
+    LCE_uniform::reseed(1);
+    MultiAssetWithPath_BS paths(S0, T, sigma, r, q, CorrelationFactor({{1., rho}, {rho, 1.}}), N, 1, StandardGaussianMatrix::gen(2 * N));
+    std::vector<double> V(exchange(paths));
+    RunningStatistics stats;
+    stats.Add(V.data(), V.size());
+    
+    const double discount = std::exp(-r * T);
+    const double MC_price = discount * stats.Mean();
+    const double std_error = discount * stats.StdError();
+    const double closed_form = discount * exchange.MargrabePrice(S0, T, sigma, r, q, rho);
+    std::cout << MC_price << '\t' << std_error << '\t' << closed_form << std::endl;
+    return std::abs(MC_price - closed_form) <= 3. * std_error;
+}
+
 double Final(std::size_t M, std::size_t N, unsigned long seed) {
     
     EuropeanOption option(0., 70., 80., .5, .5, .02, .02);
@@ -99,42 +187,35 @@ double Final(std::size_t M, std::size_t N, unsigned long seed) {
 }
 
 void Final(std::size_t M, std::size_t N) {
-    EuropeanOption option(0., 70., 80., .5, .5, .02, .02);
-//    std::cout << option.Call() << std::endl;
-    AsianOption asian(option, Call);
-    
-    std::vector<double> val;
-    
-    for (unsigned long seed = 1; seed <= 100; seed++) {
-        LCE_uniform::reseed(seed);
-        std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(N, M));
-        std::vector<std::vector<double>> S(OneAssetWithPath_BS(option.S_, option.T_, option.sigma_, option.r_, option.q_, Z).S);
-        
-        std::vector<double> V(S.size());
-        std::transform(S.cbegin(), S.cend(), V.begin(), asian);
-        
-        
-        val.push_back(std::accumulate(V.cbegin(), V.cend(), 0.) / V.size() * std::exp(-option.r_ * option.T_));
-    }
     
-    double sum = std::accumulate(val.cbegin(), val.cend(), 0.);
-    double sumsq = std::inner_product(val.cbegin(), val.cend(), val.cbegin(), 0.);
+    // 100 replications (seeds 1..100) spread over all cores
+    ReplicationHarness harness;
+    ReplicationResults res = harness.Run([=](unsigned long seed)->double { return Final(M, N, seed); }, 100, 1, N);
     
-    double avg = sum / val.size();
-    double stdev = std::sqrt((sumsq - sum * avg) / (double(val.size()) - 1.));
-    
-    std::cout << avg << '\t' << stdev << std::endl;
+    res.Print();
     
 }
 
 int main(int argc, const char * argv[]) {
     
     std::cout << std::fixed << std::setprecision(8);
+    
+    // Self-checks, run by ctest: MonteCarloPricer --test odd-paths|shards|margrabe exits nonzero on failure
+    if (argc == 3 && std::strcmp(argv[1], "--test") == 0) {
+        if (std::strcmp(argv[2], "odd-paths") == 0) return TestOddPaths() ? 0 : 1;
+        if (std::strcmp(argv[2], "shards") == 0) return TestShards() ? 0 : 1;
+        if (std::strcmp(argv[2], "margrabe") == 0) return TestMargrabe() ? 0 : 1;
+        std::cerr << argv[0] << ": unknown test " << argv[2] << std::endl;
+        return 2;
+    }
 //    TestAnalyzer();
 //    PriceAndGreek();
 //    VarRed();
 //    TestDividend();
 //    TestBarrier();
+//    TestOddPaths();
+//    TestPrecision();
+//    TestShards();
     std::vector<std::size_t> Ms({100, 200, 300, 400, 500, 600});
     std::vector<std::size_t> Ns({250, 1000, 2250, 4000, 6250, 9000});
     
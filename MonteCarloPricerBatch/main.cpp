@@ -0,0 +1,133 @@
+//
+//  main.cpp
+//  MonteCarloPricerBatch
+//
+//  Prices a trade file (CSV or JSON lines, see TradeFile.hpp) and streams one CSV line per trade,
+//  or, with --serve, answers JSON-line requests on stdin or a Unix domain socket (see PricingServer.hpp)
+//  --cache-dir keeps the results on disk, so a rerun only simulates the trades whose inputs changed
+//  usage: MonteCarloPricerBatch trades.csv|trades.jsonl [--output file] [--threads n] [--block-size n] [--cache-dir dir]
+//         MonteCarloPricerBatch --serve [--socket path] [--threads n] [--block-size n] [--cache-mb n] [--cache-dir dir]
+//
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "PricingServer.hpp"
+#include "ResultCache.hpp"
+#include "TradeFile.hpp"
+#include "TradePricer.hpp"
+#include "ThreadPool.hpp"
+
+namespace {
+
+const char* TypeName(TradeType type) {
+    switch (type) {
+        case BarrierTrade: return "barrier";
+        case AsianTrade: return "asian";
+        case VanillaTrade:
+        default: return "vanilla";
+    }
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+    
+    std::string input;
+    std::string output;
+    std::string socket;
+    std::string cache_dir;
+    unsigned num_threads = 0;
+    std::size_t block_size = 1 << 13;
+    std::size_t cache_mb = 256;
+    bool serve = (argc >= 2 && std::strcmp(argv[1], "--serve") == 0);
+    bool bad_usage = (argc < 2);
+    if (!bad_usage && !serve) input = argv[1];
+    for (int i = 2; i < argc && !bad_usage; i += 2) {
+        if (i + 1 >= argc) bad_usage = true;
+        else if (std::strcmp(argv[i], "--output") == 0 && !serve) output = argv[i + 1];
+        else if (std::strcmp(argv[i], "--socket") == 0 && serve) socket = argv[i + 1];
+        else if (std::strcmp(argv[i], "--cache-mb") == 0 && serve) cache_mb = std::stoul(argv[i + 1]);
+        else if (std::strcmp(argv[i], "--cache-dir") == 0) cache_dir = argv[i + 1];
+        else if (std::strcmp(argv[i], "--threads") == 0) num_threads = static_cast<unsigned>(std::stoul(argv[i + 1]));
+        else if (std::strcmp(argv[i], "--block-size") == 0) block_size = std::stoul(argv[i + 1]);
+        else bad_usage = true;
+    }
+    if (block_size == 0) bad_usage = true;
+    if (bad_usage) {
+        std::cerr << "usage: " << argv[0] << " trades.csv|trades.jsonl [--output file] [--threads n] [--block-size n] [--cache-dir dir]" << std::endl;
+        std::cerr << "       " << argv[0] << " --serve [--socket path] [--threads n] [--block-size n] [--cache-mb n] [--cache-dir dir]" << std::endl;
+        return 1;
+    }
+    
+    if (serve) {
+        try {
+            PricingServer server(num_threads, cache_mb << 20, block_size, cache_dir);
+            if (socket.empty()) {
+                server.ServeStream(STDIN_FILENO, STDOUT_FILENO);
+            } else {
+                server.ServeSocket(socket);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << argv[0] << ": " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    try {
+        TradeFile file(input);
+        const std::vector<Trade>& trades = file.Trades();
+        const double parse_seconds = SecondsSince(start);
+        
+        std::ofstream stream;
+        if (!output.empty()) {
+            stream.open(output);
+            if (!stream) throw std::runtime_error("cannot open " + output);
+        }
+        std::ostream& os = output.empty() ? std::cout : stream;
+        os << std::setprecision(10);
+        os << "id,underlying,type,value,std_error,error\n";
+        
+        // Results stream out as groups finish, so lines follow completion order
+        std::size_t failed = 0;
+        ThreadPool pool(num_threads);
+        std::unique_ptr<ResultCache> results;
+        if (!cache_dir.empty()) results = std::make_unique<ResultCache>(std::size_t(1) << 20, cache_dir);
+        TradePricer(block_size, nullptr, results.get()).PriceAll(trades, pool, [&](const std::vector<TradeResult>& results) {
+            for (const TradeResult& res : results) {
+                const Trade& trade = trades[res.index];
+                os << trade.id << ',' << trade.underlying << ',' << TypeName(trade.type) << ',';
+                if (res.error.empty()) {
+                    os << res.value << ',' << res.std_error << ",\n";
+                } else {
+                    os << ",," << res.error << '\n';
+                    failed++;
+                }
+            }
+        });
+        os.flush();
+        if (!os) throw std::runtime_error("cannot write " + (output.empty() ? std::string("results") : output));
+        
+        const double seconds = SecondsSince(start);
+        std::cerr << trades.size() << " trades (" << TradePricer::Group(trades).size() << " simulations, " << failed << " failed) on " << pool.NumThreads() << " threads: parsed in " << parse_seconds << " s, total " << seconds << " s" << std::endl;
+        if (results) std::cerr << "result cache: " << results->Hits() << " hits (" << results->DiskHits() << " from disk), " << results->Misses() << " misses" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,357 @@
+//
+//  main.cpp
+//  MonteCarloPricerBenchmark
+//
+//  Throughput of the generators and efficiency (variance x CPU time) of the estimators
+//  Every timed run follows an untimed warm-up, and times are medians over repeated runs
+//  usage: MonteCarloPricerBenchmark [--format csv|json] [--scale x] [--output file]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "RNG.hpp"
+#include "PathGenerator.hpp"
+#include "HestonModel.hpp"
+#include "JumpDiffusion.hpp"
+#include "LocalVolatility.hpp"
+#include "MultiAssetPathGenerator.hpp"
+#include "EuropeanOptionAnalyzer.hpp"
+#include "BarrierOptionAnalyzer.hpp"
+#include "MixedPrecision.hpp"
+#include "Statistics.hpp"
+
+struct BenchmarkRecord {
+    std::string suite;
+    std::string name;
+    std::size_t param;      // Path length, N, ... (0 if none)
+    double items;           // Numbers, paths or samples per run
+    double seconds;         // Wall-clock per run
+    double cpu_seconds;     // CPU per run
+    double value;           // Mean estimate (NaN if not an estimator)
+    double reference;       // Closed form
+    double variance;        // Of one run's estimate, across seeds
+    
+    double Throughput() const { return items / seconds; }
+    double Efficiency() const { return variance * cpu_seconds; }
+};
+
+class Stopwatch {
+    // Wall-clock and process CPU time
+private:
+    std::chrono::steady_clock::time_point wall_;
+    std::clock_t cpu_;
+    
+public:
+    Stopwatch() : wall_(std::chrono::steady_clock::now()), cpu_(std::clock()) {}
+    
+    double Seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_).count(); }
+    double CPUSeconds() const { return double(std::clock() - cpu_) / CLOCKS_PER_SEC; }
+};
+
+namespace {
+
+const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+// Keeps the optimizer from discarding benchmarked results
+volatile double sink;
+
+// Timed runs per throughput measurement
+const std::size_t timing_repeats = 5;
+
+double Median(std::vector<double> x) {
+    std::sort(x.begin(), x.end());
+    const std::size_t n = x.size();
+    return (n % 2) ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2.;
+}
+
+// An untimed warm-up run (page faults, caches, lazy initialization), then the median of timing_repeats runs
+BenchmarkRecord Throughput(const std::string& suite, const std::string& name, std::size_t param, double items, const std::function<double ()>& run) {
+    sink = run();
+    
+    std::vector<double> seconds, cpu_seconds;
+    for (std::size_t i = 0; i < timing_repeats; i++) {
+        Stopwatch watch;
+        sink = run();
+        seconds.push_back(watch.Seconds());
+        cpu_seconds.push_back(watch.CPUSeconds());
+    }
+    return BenchmarkRecord({suite, name, param, items, Median(seconds), Median(cpu_seconds), NaN, NaN, NaN});
+}
+
+// One estimate per seed; the variance is across seeds, the times are the median per estimate
+// An untimed warm-up estimate, on a seed outside the replications, comes first
+BenchmarkRecord Efficiency(const std::string& suite, const std::string& name, std::size_t param, double items, double reference, std::size_t replications, const std::function<double (unsigned long)>& estimate) {
+    sink = estimate(replications + 1);
+    
+    RunningStatistics stats;
+    std::vector<double> seconds, cpu_seconds;
+    for (unsigned long seed = 1; seed <= replications; seed++) {
+        Stopwatch watch;
+        stats.Add(estimate(seed));
+        seconds.push_back(watch.Seconds());
+        cpu_seconds.push_back(watch.CPUSeconds());
+    }
+    return BenchmarkRecord({suite, name, param, items, Median(seconds), Median(cpu_seconds), stats.Mean(), reference, stats.Variance()});
+}
+
+// An even count (normals come in pairs), never zero however small the scale
+std::size_t Scaled(double count, double scale) {
+    return std::max<std::size_t>(static_cast<std::size_t>(count * scale) / 2 * 2, 2);
+}
+
+void BenchmarkRNG(std::vector<BenchmarkRecord>& records, double scale) {
+    const std::size_t n = Scaled(4000000, scale);
+    
+    LCE_uniform::reseed(1);
+    records.push_back(Throughput("rng", "LCE_uniform", 0, n, [=]() {
+        double sum = 0.;
+        for (std::size_t i = 0; i < n; i++) sum += LCE_uniform::gen();
+        return sum;
+    }));
+    records.push_back(Throughput("rng", "BSM", 0, n, [=]() {
+        double sum = 0.;
+        for (std::size_t i = 0; i < n; i++) sum += BSM::standard_normal();
+        return sum;
+    }));
+    records.push_back(Throughput("rng", "Rejection", 0, n, [=]() {
+        double sum = 0.;
+        for (std::size_t i = 0; i < n; i++) sum += Rejection::standard_normal();
+        return sum;
+    }));
+    records.push_back(Throughput("rng", "MarsagliaBray", 0, n, [=]() {
+        double sum = 0.;
+        for (std::size_t i = 0; i < n; i += 2) {
+            std::pair<double, double> z = MarsagliaBray::standard_normal_pair();
+            sum += z.first + z.second;
+        }
+        return sum;
+    }));
+    records.push_back(Throughput("rng", "Rng", 0, n, [=]() {
+        double sum = 0.;
+        for (std::size_t i = 0; i < n; i++) sum += Rng::gen();
+        return sum;
+    }));
+    records.push_back(Throughput("rng", "StandardGaussianMatrix", 0, n, [=]() {
+        return StandardGaussianMatrix::gen(n).back();
+    }));
+}
+
+void BenchmarkPaths(std::vector<BenchmarkRecord>& records, double scale) {
+    const double S0 = 41., T = .75, sigma = .25, r = .03, q = .01;
+    const std::size_t path_length = 50;
+    const std::size_t num_paths = Scaled(40000, scale);
+    
+    // Normals are drawn up front: only the path construction is timed
+    LCE_uniform::reseed(1);
+    const std::vector<double> z_flat(StandardGaussianMatrix::gen(num_paths * path_length));
+    const std::vector<double> z_end(StandardGaussianMatrix::gen(num_paths));
+    const std::vector<std::vector<double>> Z(StandardGaussianMatrix::gen(num_paths, path_length));
+    const std::vector<double> z_heston(StandardGaussianMatrix::gen(2 * num_paths * path_length));
+    
+    records.push_back(Throughput("paths", "OneAssetNoPath_BS", 1, num_paths, [&]() {
+        return OneAssetNoPath_BS(S0, T, sigma, r, q, z_end).S.back();
+    }));
+    records.push_back(Throughput("paths", "OneAssetWithPath_BS", path_length, num_paths, [&]() {
+        return OneAssetWithPath_BS(S0, T, sigma, r, q, Z).S.back().back();
+    }));
+    
+    Dividend proportional({{.25}, {.02}});
+    Dividend fixed({{.5}, {.5}});
+    DividendSchedule schedule(T, sigma, r, q, proportional, fixed);
+    const std::vector<std::vector<double>> Z_dividend(StandardGaussianMatrix::gen(num_paths, schedule.Intervals()));
+    records.push_back(Throughput("paths", "OneAssetWithPath_BS (dividends)", schedule.Intervals(), num_paths, [&]() {
+        return OneAssetWithPath_BS(S0, Z_dividend, schedule).S.back().back();
+    }));
+    
+    records.push_back(Throughput("paths", "OneAssetPathBlock_BS", path_length, num_paths, [&]() {
+        return OneAssetPathBlock_BS(S0, T, sigma, r, q, num_paths, path_length, z_flat.data()).S.back();
+    }));
+    const std::vector<float> z_float(z_flat.cbegin(), z_flat.cend());
+    records.push_back(Throughput("paths", "BasicOneAssetPathBlock_BS<float>", path_length, num_paths, [&]() {
+        return BasicOneAssetPathBlock_BS<float>(S0, T, sigma, r, q, num_paths, path_length, z_float.data()).S.back();
+    }));
+    records.push_back(Throughput("paths", "OneAssetExtremeBlock_BS", path_length, num_paths, [&]() {
+        return OneAssetExtremeBlock_BS(S0, T, sigma, r, q, Z, true).extreme.back();
+    }));
+    records.push_back(Throughput("paths", "OneAssetPathBlock_Merton", path_length, num_paths, [&]() {
+        return OneAssetPathBlock_Merton(S0, T, sigma, r, q, MertonJump({1., -.1, .15}), Z).S.back();
+    }));
+    records.push_back(Throughput("paths", "OneAssetPathBlock_Heston", path_length, num_paths, [&]() {
+        return OneAssetPathBlock_Heston(S0, T, r, q, HestonParameters({.0625, 2., .0625, .5, -.7}), num_paths, path_length, z_heston).S.back();
+    }));
+    
+    LocalVolGrid grid(LocalVolSurface([](double t, double S) { return .2 + .1 * std::exp(-S / 50.) + .02 * t; }), S0, T, path_length);
+    records.push_back(Throughput("paths", "OneAssetPathBlock_LocalVol", path_length, num_paths, [&]() {
+        return OneAssetPathBlock_LocalVol(S0, r, q, grid, Z).S.back();
+    }));
+    
+    // Two assets, the same number of normals as above
+    CorrelationFactor factor({{1., .5}, {.5, 1.}});
+    records.push_back(Throughput("paths", "MultiAssetWithPath_BS (2 assets)", path_length / 2, num_paths, [&]() {
+        return MultiAssetWithPath_BS({S0, S0}, T, {sigma, sigma}, r, {q, q}, factor, num_paths, path_length / 2, z_flat).S.back().S.back();
+    }));
+}
+
+void BenchmarkVarRed(std::vector<BenchmarkRecord>& records, double scale) {
+    EuropeanOption option(0., 41., 42., .75, .25, .03, .01);
+    EuropeanOptionAnalyzer analyzer(option);
+    const std::size_t N = Scaled(200000, scale);
+    const std::size_t replications = 16;
+    
+    const std::vector<std::pair<EuropeanOptionAnalyzer::VarRed, std::string>> modes({
+        {EuropeanOptionAnalyzer::vanilla, "vanilla"},
+        {EuropeanOptionAnalyzer::control_variate, "control_variate"},
+        {EuropeanOptionAnalyzer::antithetic_variables, "antithetic_variables"},
+        {EuropeanOptionAnalyzer::moment_matching, "moment_matching"},
+        {EuropeanOptionAnalyzer::MMCV, "MMCV"},
+    });
+    
+    for (const auto& mode : modes) {
+        records.push_back(Efficiency("varred", mode.second, N, N, option.Put(), replications, [&](unsigned long seed) {
+            return analyzer.Price(N, EuropeanOptionAnalyzer::put, mode.first, seed);
+        }));
+    }
+}
+
+void BenchmarkBarrier(std::vector<BenchmarkRecord>& records, double scale) {
+    EuropeanOption option(0., 42., 40., 7. / 12., .25, .03, .015);
+    BarrierOption barrier_option(option, 35., Call, DownAndOut);
+    BarrierOptionAnalyzer analyzer(barrier_option);
+    const std::size_t num_paths = Scaled(20000, scale);
+    const std::size_t replications = 8;
+    
+    // Discrete monitoring: value - reference also shows the discretization bias
+    for (std::size_t path_length : {25, 50, 100, 200, 400}) {
+        records.push_back(Efficiency("barrier", "DownAndOut call", path_length, num_paths, barrier_option.BSPrice(), replications, [&](unsigned long seed) {
+            return analyzer.Price(path_length, num_paths, static_cast<unsigned>(seed));
+        }));
+    }
+}
+
+void BenchmarkPrecision(std::vector<BenchmarkRecord>& records, double scale) {
+    EuropeanOption option(0., 42., 40., 7. / 12., .25, .03, .015);
+    BarrierOption barrier_option(option, 35., Call, DownAndOut);
+    const std::size_t path_length = 100;
+    const std::size_t num_paths = Scaled(20000, scale);
+    const std::size_t replications = 8;
+    
+    // Same normals in every mode: the values differ by rounding only
+    records.push_back(Efficiency("precision", "float64", path_length, num_paths, barrier_option.BSPrice(), replications, [&](unsigned long seed) {
+        return MixedPrecision::Price<double, PlainAccumulator<double>>(option, barrier_option, path_length, num_paths, seed).value;
+    }));
+    records.push_back(Efficiency("precision", "float32, double sums", path_length, num_paths, barrier_option.BSPrice(), replications, [&](unsigned long seed) {
+        return MixedPrecision::Price<float, PlainAccumulator<double>>(option, barrier_option, path_length, num_paths, seed).value;
+    }));
+    records.push_back(Efficiency("precision", "float32, Kahan float sums", path_length, num_paths, barrier_option.BSPrice(), replications, [&](unsigned long seed) {
+        return MixedPrecision::Price<float, KahanAccumulator<float>>(option, barrier_option, path_length, num_paths, seed).value;
+    }));
+}
+
+// Sizes are scaled from the defaults; past max_scale they would no longer fit in memory
+const double max_scale = 1000.;
+
+// Whole string a number in (0, max_scale]
+bool ParseScale(const char* arg, double& scale) {
+    std::size_t end = 0;
+    double x = 0.;
+    try {
+        x = std::stod(arg, &end);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (arg[end] != '\0' || !(x > 0.) || !(x <= max_scale)) return false;
+    scale = x;
+    return true;
+}
+
+void WriteCSV(std::ostream& os, const std::vector<BenchmarkRecord>& records) {
+    os << "suite,name,param,items,seconds,cpu_seconds,throughput,value,reference,variance,efficiency\n";
+    for (const BenchmarkRecord& rec : records) {
+        os << rec.suite << ",\"" << rec.name << "\"," << rec.param << ',' << rec.items << ',' << rec.seconds << ',' << rec.cpu_seconds << ',' << rec.Throughput() << ',' << rec.value << ',' << rec.reference << ',' << rec.variance << ',' << rec.Efficiency() << '\n';
+    }
+}
+
+void WriteJSON(std::ostream& os, const std::vector<BenchmarkRecord>& records) {
+    // NaN is not valid JSON
+    auto number = [](double x)->std::string {
+        if (std::isnan(x)) return "null";
+        std::ostringstream ss;
+        ss << std::setprecision(10) << x;
+        return ss.str();
+    };
+    
+    os << "[\n";
+    for (std::size_t i = 0; i < records.size(); i++) {
+        const BenchmarkRecord& rec = records[i];
+        os << "  {\"suite\": \"" << rec.suite << "\", \"name\": \"" << rec.name << "\", \"param\": " << rec.param
+           << ", \"items\": " << number(rec.items) << ", \"seconds\": " << number(rec.seconds) << ", \"cpu_seconds\": " << number(rec.cpu_seconds)
+           << ", \"throughput\": " << number(rec.Throughput()) << ", \"value\": " << number(rec.value) << ", \"reference\": " << number(rec.reference)
+           << ", \"variance\": " << number(rec.variance) << ", \"efficiency\": " << number(rec.Efficiency()) << "}" << (i + 1 < records.size() ? "," : "") << '\n';
+    }
+    os << "]\n";
+}
+
+}
+
+int main(int argc, const char * argv[]) {
+    
+    std::string format = "csv";
+    std::string output;
+    double scale = 1.;
+    bool bad_usage = false;
+    for (int i = 1; i < argc && !bad_usage; i += 2) {
+        if (i + 1 >= argc) bad_usage = true;
+        else if (std::strcmp(argv[i], "--format") == 0) format = argv[i + 1];
+        else if (std::strcmp(argv[i], "--scale") == 0) bad_usage = !ParseScale(argv[i + 1], scale);
+        else if (std::strcmp(argv[i], "--output") == 0) output = argv[i + 1];
+        else bad_usage = true;
+    }
+    if (bad_usage || (format != "csv" && format != "json")) {
+        std::cerr << "usage: " << argv[0] << " [--format csv|json] [--scale x] [--output file]" << std::endl;
+        std::cerr << "  x: a number in (0, " << max_scale << "]" << std::endl;
+        return 1;
+    }
+    
+    // Opened before the runs, so a bad path fails fast
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output);
+        if (!file) {
+            std::cerr << argv[0] << ": cannot open " << output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& os = output.empty() ? std::cout : file;
+    
+    std::vector<BenchmarkRecord> records;
+    BenchmarkRNG(records, scale);
+    BenchmarkPaths(records, scale);
+    BenchmarkVarRed(records, scale);
+    BenchmarkBarrier(records, scale);
+    BenchmarkPrecision(records, scale);
+    
+    os << std::setprecision(10);
+    if (format == "json") {
+        WriteJSON(os, records);
+    } else {
+        WriteCSV(os, records);
+    }
+    os.flush();
+    if (!os) {
+        std::cerr << argv[0] << ": cannot write " << (output.empty() ? std::string("results") : output) << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}